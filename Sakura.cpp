@@ -19,13 +19,11 @@
  ***************************************************************************/
 
 #include "Sakura.h"
-#include "figures.h"
 #include "graphics.h"
 
 std::vector<std::pair<int, int> > SakuraMatrix::__delta;
-SakuraMatrix::FiguresType SakuraMatrix::__figures;
-SakuraMatrix::FigureImagesType SakuraMatrix::__figure_images;
 ApplicationCommandManager *MainWindow::__pCommandManager = 0;
+PhaseTimer MainWindow::__startupPhases;
 
 MainWindow::MainWindow(const String &name, const Colour &backgroundColour, const int requiredButtons, const bool addToDesktop) :
 	DocumentWindow(name, backgroundColour, requiredButtons, addToDesktop),
@@ -43,10 +41,12 @@ MainWindow::MainWindow(const String &name, const Colour &backgroundColour, const
 }
 
 SakuraMatrix::SakuraMatrix(MainWindow *pParentComponent) :
-	_x_root_cell(0),
-	_y_root_cell(0),
+	_engine(_board, this),
+	_pSnapshot(nullptr),
+	_boardMemory(0),
+	_pViewport(nullptr),
+	_pBoardView(nullptr),
 	_infiniteMode(false),
-	_infiniteMode_current(false),
 	_solved(false),
 	_peekMode(false),
 	_autoShuffle(true),
@@ -58,6 +58,10 @@ SakuraMatrix::SakuraMatrix(MainWindow *pParentComponent) :
 	_keyboardSupport(false),
 	_x_focus(0),
 	_y_focus(0),
+	_firstFrameShown(false),
+	_showOverlay(false),
+	_inputTicks(0),
+	_recordSession(false),
 	_pBackImage(nullptr),
 	_pParentComponent(pParentComponent),
 	_pStatusBar(nullptr),
@@ -65,16 +69,12 @@ SakuraMatrix::SakuraMatrix(MainWindow *pParentComponent) :
 	_numberOfCellsX(7),
 	_numberOfCellsY(6),
 	_cellSize(48),
+	_visibleCellsX(_numberOfCellsX),
+	_visibleCellsY(_numberOfCellsY),
+	_zoomCellSize(_cellSize),
 	_relaxMatrix(.1f),
-	_decor_side_right(nullptr),
-	_decor_side_left(nullptr),
-	_decor_side_bottom(nullptr),
-	_decor_conner_left(nullptr),
-	_decor_conner_right(nullptr),
-	_decor_conner_left_top(nullptr),
-	_decor_conner_right_top(nullptr),
-	_decor_butterfly_left(nullptr),
-	_decor_title(nullptr),
+	_puzzlePackPosition(0),
+	_generateFromPack(false),
 	_tempWidthInCells(_numberOfCellsX),
 	_tempHeightInCells(_numberOfCellsY),
 	_tempCellSize(_cellSize),
@@ -86,6 +86,9 @@ SakuraMatrix::SakuraMatrix(MainWindow *pParentComponent) :
 	_pAutoShuffleModeProperty(nullptr),
 	_pAutoShuffleMillisecondsProperty(nullptr),
 	_pKeyboardSupportProperty(nullptr),
+	_pGenerateFromPackProperty(nullptr),
+	_pOpenPuzzlePackProperty(nullptr),
+	_pRecordSessionProperty(nullptr),
 	_pKeyMappingsProperty(nullptr)
 {
 	std::srand(std::time(nullptr));
@@ -108,8 +111,18 @@ SakuraMatrix::SakuraMatrix(MainWindow *pParentComponent) :
 		_pParentComponent->addKeyListener(MainWindow::__pCommandManager->getKeyMappings());
 	}
 
-	generateDecor();
-	generateFigures();
+	MainWindow::__startupPhases.mark("command manager");
+
+	_renderer.loadDecor();
+
+	MainWindow::__startupPhases.mark("decor");
+
+	_renderer.loadFigures();
+
+	MainWindow::__startupPhases.mark("figures");
+
+	addAndMakeVisible(_pViewport = new Viewport());
+	_pViewport->setViewedComponent(_pBoardView = new BoardView(this));
 
 	addAndMakeVisible(_pStatusBar = new StatusBarComponent(this));
 
@@ -133,6 +146,12 @@ SakuraMatrix::SakuraMatrix(MainWindow *pParentComponent) :
 	additinalProperties.add(_pSwapMouseWheelDirectionsProperty = new BooleanValuePropertyComponent<SakuraMatrix>(T("swap mouse wheel directions"), T("yes"), T("no"), _swapMouseWheelDirections));
 	additinalProperties.add(_pKeyboardSupportProperty = new BooleanValuePropertyComponent<SakuraMatrix>(T("keyboard"), T("enabled"), T("disabled"), _keyboardSupport, this));
 	_pKeyboardSupportProperty->setTooltip(T("enables keyboard support thus letting you move and rotate cells by using keyboard buttons"));
+	additinalProperties.add(_pOpenPuzzlePackProperty = new ProxyButtonPropertyComponent<SakuraMatrix>(T("puzzle pack"), T("Open..."), false, this));
+	_pOpenPuzzlePackProperty->setTooltip(T("opens a pack of curated puzzles"));
+	additinalProperties.add(_pGenerateFromPackProperty = new BooleanValuePropertyComponent<SakuraMatrix>(T("generate"), T("next puzzle from pack"), T("random branch"), _generateFromPack, this));
+	_pGenerateFromPackProperty->setTooltip(T("<next puzzle from pack>: takes the puzzles of the opened pack one after another\n\n<random branch>: generates a new random branch"));
+	additinalProperties.add(_pRecordSessionProperty = new BooleanValuePropertyComponent<SakuraMatrix>(T("session"), T("recording"), T("not recorded"), _recordSession, this));
+	_pRecordSessionProperty->setTooltip(T("records your moves into the \"sessions\" folder next to the autosave, so they can be replayed by the benchmark"));
 
 	Array<PropertyComponent*> keymappingsProperties;
 	keymappingsProperties.add(_pKeyMappingsProperty = new KeyMappingsPropertyComponent(T("keyboard"), MainWindow::__pCommandManager->getKeyMappings()));
@@ -142,223 +161,141 @@ SakuraMatrix::SakuraMatrix(MainWindow *pParentComponent) :
 	_pSettingsPanel->addSection(T("Additinal properties"), additinalProperties, true);
 	_pSettingsPanel->addSection(T("Key-mapping properties"), keymappingsProperties, true);
 
+	MainWindow::__startupPhases.mark("property panel");
+
+	_renderer.setCellSize(_cellSize);
+
+	MainWindow::__startupPhases.mark("figure rasterization");
+
+	_engine.startThread();
+
 	buildMatrix(_numberOfCellsX, _numberOfCellsY, _cellSize);
 
+	MainWindow::__startupPhases.mark("first branch");
+
 	_pParentComponent->centreAroundComponent(0, getWidth(), getHeight());
 }
 
 SakuraMatrix::~SakuraMatrix()
 {
+	// no result may come back to the components any more
+	_engine.stopThread(10000);
+
 	deleteAllChildren();
 
-	for(FiguresType::iterator it = __figures.begin(), end = __figures.end(); it != end; it++)
-		for(sakura_map<int, Drawable*>::iterator it2 = (*it).second.begin(), end2 = (*it).second.end(); it2 != end2; it2++)
-			delete (*it2).second;
+	delete MainWindow::__pCommandManager;
+	MainWindow::__pCommandManager = nullptr;
+}
+
+void SakuraMatrix::paint(Graphics &g)
+{
+	SAKURA_TRACE_SCOPE("paint");
 
-	__figures.clear();
+	if(!_pBackImage)
+		generateBackground();
 
-	for(FigureImagesType::iterator it = __figure_images.begin(), end = __figure_images.end(); it != end; it++)
-		for(sakura_map<int, Image*>::iterator it2 = (*it).second.begin(), end2 = (*it).second.end(); it2 != end2; it2++)
-			delete (*it2).second;
+	g.drawImageAt(_pBackImage, 0, 0, false);
+}
 
-	__figure_images.clear();
+// The overlay refreshing itself would push the interesting frames off the overlay.
+bool SakuraMatrix::isCountedFrame(const Component *pComponent, const Rectangle &clip) const
+{
+	if(!_showOverlay)
+		return true;
 
-	delete _decor_side_right;
-	delete _decor_side_left;
-	delete _decor_side_bottom;
-	delete _decor_conner_left;
-	delete _decor_conner_right;
-	delete _decor_conner_left_top;
-	delete _decor_conner_right_top;
-	delete _decor_butterfly_left;
-	delete _decor_title;
+	int x = clip.getX();
+	int y = clip.getY();
 
-	delete MainWindow::__pCommandManager;
-	MainWindow::__pCommandManager = nullptr;
+	pComponent->relativePositionToOtherComponent(this, x, y);
+
+	return !getOverlayBounds().contains(Rectangle(x, y, clip.getWidth(), clip.getHeight()));
 }
 
-void SakuraMatrix::generateDecor()
-{
-	XmlDocument doc_side_right(String((const char*)SIDE_RIGHT_SVG));
-	XmlDocument doc_side_left(String((const char*)SIDE_LEFT_SVG));
-	XmlDocument doc_side_bottom(String((const char*)SIDE_BOTTOM_SVG));
-	XmlDocument doc_conner_left(String((const char*)BORDER_CONNER_LEFT_SVG));
-	XmlDocument doc_conner_right(String((const char*)BORDER_CONNER_RIGHT_SVG));
-	XmlDocument doc_conner_left_top(String((const char*)BORDER_CONNER_LEFT_TOP_SVG));
-	XmlDocument doc_conner_right_top(String((const char*)BORDER_CONNER_RIGHT_TOP_SVG));
-	XmlDocument doc_butterfly_left(String((const char*)BUTTERFLY_LEFT_SVG));
-	XmlDocument doc_title(String((const char*)SAKURA_TITLE_SVG));
-
-	_decor_side_right = Drawable::createFromSVG(*doc_side_right.getDocumentElement());
-	_decor_side_left = Drawable::createFromSVG(*doc_side_left.getDocumentElement());
-	_decor_side_bottom = Drawable::createFromSVG(*doc_side_bottom.getDocumentElement());
-	_decor_conner_left = Drawable::createFromSVG(*doc_conner_left.getDocumentElement());
-	_decor_conner_right = Drawable::createFromSVG(*doc_conner_right.getDocumentElement());
-	_decor_conner_left_top = Drawable::createFromSVG(*doc_conner_left_top.getDocumentElement());
-	_decor_conner_right_top = Drawable::createFromSVG(*doc_conner_right_top.getDocumentElement());
-	_decor_butterfly_left = Drawable::createFromSVG(*doc_butterfly_left.getDocumentElement());
-	_decor_title = Drawable::createFromSVG(*doc_title.getDocumentElement());
-}
-
-void SakuraMatrix::generateFigures()
-{
-	for(FiguresType::iterator it = __figures.begin(), end = __figures.end(); it != end; ++it)
-		for(sakura_map<int, Drawable*>::iterator it2 = (*it).second.begin(), end2 = (*it).second.end(); it2 != end2; ++it2)
-			delete (*it2).second;
-
-	__figures.clear();
-
-	XmlDocument doc_0011(String((const char*)_0011_SVG));
-	XmlDocument doc_0011_LIVE(String((const char*)_0011_LIVE_SVG));
-	XmlDocument doc_0011_SOLVED(String((const char*)_0011_SOLVED_SVG));
-	XmlDocument doc_0101(String((const char*)_0101_SVG));
-	XmlDocument doc_0101_LIVE(String((const char*)_0101_LIVE_SVG));
-	XmlDocument doc_0101_SOLVED(String((const char*)_0101_SOLVED_SVG));
-	XmlDocument doc_0110(String((const char*)_0110_SVG));
-	XmlDocument doc_0110_LIVE(String((const char*)_0110_LIVE_SVG));
-	XmlDocument doc_0110_SOLVED(String((const char*)_0110_SOLVED_SVG));
-	XmlDocument doc_0111(String((const char*)_0111_SVG));
-	XmlDocument doc_0111_LIVE(String((const char*)_0111_LIVE_SVG));
-	XmlDocument doc_0111_SOLVED(String((const char*)_0111_SOLVED_SVG));
-	XmlDocument doc_1001(String((const char*)_1001_SVG));
-	XmlDocument doc_1001_LIVE(String((const char*)_1001_LIVE_SVG));
-	XmlDocument doc_1001_SOLVED(String((const char*)_1001_SOLVED_SVG));
-	XmlDocument doc_1010(String((const char*)_1010_SVG));
-	XmlDocument doc_1010_LIVE(String((const char*)_1010_LIVE_SVG));
-	XmlDocument doc_1010_SOLVED(String((const char*)_1010_SOLVED_SVG));
-	XmlDocument doc_1011(String((const char*)_1011_SVG));
-	XmlDocument doc_1011_LIVE(String((const char*)_1011_LIVE_SVG));
-	XmlDocument doc_1011_SOLVED(String((const char*)_1011_SOLVED_SVG));
-	XmlDocument doc_1100(String((const char*)_1100_SVG));
-	XmlDocument doc_1100_LIVE(String((const char*)_1100_LIVE_SVG));
-	XmlDocument doc_1100_SOLVED(String((const char*)_1100_SOLVED_SVG));
-	XmlDocument doc_1101(String((const char*)_1101_SVG));
-	XmlDocument doc_1101_LIVE(String((const char*)_1101_LIVE_SVG));
-	XmlDocument doc_1101_SOLVED(String((const char*)_1101_SOLVED_SVG));
-	XmlDocument doc_1110(String((const char*)_1110_SVG));
-	XmlDocument doc_1110_LIVE(String((const char*)_1110_LIVE_SVG));
-	XmlDocument doc_1110_SOLVED(String((const char*)_1110_SOLVED_SVG));
-	XmlDocument doc_1000(String((const char*)_1000_SVG));
-	XmlDocument doc_1000_LIVE(String((const char*)_1000_LIVE_SVG));
-	XmlDocument doc_1000_SOLVED(String((const char*)_1000_SOLVED_SVG));
-	XmlDocument doc_0100(String((const char*)_0100_SVG));
-	XmlDocument doc_0100_LIVE(String((const char*)_0100_LIVE_SVG));
-	XmlDocument doc_0100_SOLVED(String((const char*)_0100_SOLVED_SVG));
-	XmlDocument doc_0010(String((const char*)_0010_SVG));
-	XmlDocument doc_0010_LIVE(String((const char*)_0010_LIVE_SVG));
-	XmlDocument doc_0010_SOLVED(String((const char*)_0010_SOLVED_SVG));
-	XmlDocument doc_0001(String((const char*)_0001_SVG));
-	XmlDocument doc_0001_LIVE(String((const char*)_0001_LIVE_SVG));
-	XmlDocument doc_0001_SOLVED(String((const char*)_0001_SOLVED_SVG));
-
-
-	XmlElement *pRootDead = nullptr, *pRootLive = nullptr, *pRootSolved = nullptr;
-
-	pRootDead = doc_1000.getDocumentElement();
-	pRootLive = doc_1000_LIVE.getDocumentElement();
-	pRootSolved = doc_1000_SOLVED.getDocumentElement();
-	__figures["1000"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["1000"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["1000"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_0100.getDocumentElement();
-	pRootLive = doc_0100_LIVE.getDocumentElement();
-	pRootSolved = doc_0100_SOLVED.getDocumentElement();
-	__figures["0100"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["0100"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["0100"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_0010.getDocumentElement();
-	pRootLive = doc_0010_LIVE.getDocumentElement();
-	pRootSolved = doc_0010_SOLVED.getDocumentElement();
-	__figures["0010"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["0010"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["0010"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_0001.getDocumentElement();
-	pRootLive = doc_0001_LIVE.getDocumentElement();
-	pRootSolved = doc_0001_SOLVED.getDocumentElement();
-	__figures["0001"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["0001"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["0001"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_1100.getDocumentElement();
-	pRootLive = doc_1100_LIVE.getDocumentElement();
-	pRootSolved = doc_1100_SOLVED.getDocumentElement();
-	__figures["1100"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["1100"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["1100"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_0110.getDocumentElement();
-	pRootLive = doc_0110_LIVE.getDocumentElement();
-	pRootSolved = doc_0110_SOLVED.getDocumentElement();
-	__figures["0110"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["0110"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["0110"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_0011.getDocumentElement();
-	pRootLive = doc_0011_LIVE.getDocumentElement();
-	pRootSolved = doc_0011_SOLVED.getDocumentElement();
-	__figures["0011"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["0011"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["0011"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_1001.getDocumentElement();
-	pRootLive = doc_1001_LIVE.getDocumentElement();
-	pRootSolved = doc_1001_SOLVED.getDocumentElement();
-	__figures["1001"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["1001"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["1001"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_1010.getDocumentElement();
-	pRootLive = doc_1010_LIVE.getDocumentElement();
-	pRootSolved = doc_1010_SOLVED.getDocumentElement();
-	__figures["1010"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["1010"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["1010"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_0101.getDocumentElement();
-	pRootLive = doc_0101_LIVE.getDocumentElement();
-	pRootSolved = doc_0101_SOLVED.getDocumentElement();
-	__figures["0101"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["0101"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["0101"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_1110.getDocumentElement();
-	pRootLive = doc_1110_LIVE.getDocumentElement();
-	pRootSolved = doc_1110_SOLVED.getDocumentElement();
-	__figures["1110"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["1110"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["1110"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_0111.getDocumentElement();
-	pRootLive = doc_0111_LIVE.getDocumentElement();
-	pRootSolved = doc_0111_SOLVED.getDocumentElement();
-	__figures["0111"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["0111"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["0111"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_1011.getDocumentElement();
-	pRootLive = doc_1011_LIVE.getDocumentElement();
-	pRootSolved = doc_1011_SOLVED.getDocumentElement();
-	__figures["1011"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["1011"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["1011"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
-
-	pRootDead = doc_1101.getDocumentElement();
-	pRootLive = doc_1101_LIVE.getDocumentElement();
-	pRootSolved = doc_1101_SOLVED.getDocumentElement();
-	__figures["1101"][CellComponent::Dead] = Drawable::createFromSVG(*pRootDead);
-	__figures["1101"][CellComponent::Alive] = Drawable::createFromSVG(*pRootLive);
-	__figures["1101"][CellComponent::Solved] = Drawable::createFromSVG(*pRootSolved);
+// The board view paints on its own, as an opaque child, so the input is done with when either of them is painted.
+void SakuraMatrix::framePainted()
+{
+	if(_inputTicks)
+	{
+		_inputLatency.record(uint64(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - _inputTicks) * 1000000.));
+		_inputTicks = 0;
+	}
 }
 
-void SakuraMatrix::paint(Graphics &g)
+void SakuraMatrix::paintOverChildren(Graphics &g)
 {
-	if(!_pBackImage)
-		generateBackground();
+	framePainted();
 
-	g.drawImageAt(_pBackImage, 0, 0, false);
+	if(_showOverlay)
+		paintOverlay(g);
+
+	if(_firstFrameShown)
+		return;
+
+	// the first frame ends the startup: the phases are reported and the decor left out of it is loaded
+	_firstFrameShown = true;
+
+	MainWindow::__startupPhases.mark("first frame");
+
+	String report(MainWindow::__startupPhases.getReport());
+	File reportFile(File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile(T("Sakura")).getChildFile(T("startup.log")));
+
+	Logger::outputDebugString(report);
+
+	reportFile.getParentDirectory().createDirectory();
+	reportFile.replaceWithText(report);
+
+	if(!_renderer.hasOrnaments())
+		startTimer(loadOrnamentsTimerId, 1);
+}
+
+void SakuraMatrix::paintOverlay(Graphics &g)
+{
+	const Rectangle bounds(getOverlayBounds());
+	int x = bounds.getX() + 6;
+	int y = bounds.getY() + 16;
+
+	g.setColour(Colours::black.withAlpha(.6f));
+	g.fillRoundedRectangle(float(bounds.getX()), float(bounds.getY()), float(bounds.getWidth()), float(bounds.getHeight()), 6.f);
+
+	g.setColour(Colours::white);
+	g.setFont(12.f);
+
+#ifdef SAKURA_PROFILING
+	g.drawSingleLineText(String(T("move: rotate ")) + String(ProfileCounters::getMilliseconds(ProfileCounters::rotate), 3) +
+		T(", liveness ") + String(ProfileCounters::getMilliseconds(ProfileCounters::liveness), 3) +
+		T(", solved ") + String(ProfileCounters::getMilliseconds(ProfileCounters::solvedCheck), 3) +
+		T(", repaint ") + String(ProfileCounters::getMilliseconds(ProfileCounters::repaint), 3) + T(" ms"), x, y);
+	g.drawSingleLineText(String(T("frame: ")) + String(ProfileCounters::getFrameMilliseconds(), 2) + T(" ms, ") +
+		String(ProfileCounters::getFramePaintedCells()) + T(" cells, ") +
+		String(ProfileCounters::getFrameAllocations()) + T(" allocations"), x, y + 16);
+	g.drawSingleLineText(String(T("generator: ")) + String(ProfileCounters::getMilliseconds(ProfileCounters::generate), 2) +
+		T(" ms, alive path ") + String(ProfileCounters::getMilliseconds(ProfileCounters::alivePath), 3) + T(" ms"), x, y + 32);
+#else
+	g.drawSingleLineText(T("built without SAKURA_PROFILING: no timers"), x, y);
+#endif
+
+	g.drawSingleLineText(String(T("board memory: ")) + String(int((_boardMemory + 1023) / 1024)) + T(" KB"), x, y + 48);
+	g.drawSingleLineText(String(T("input to paint: p50 ")) + String(_inputLatency.getPercentile(.5) / 1000., 2) +
+		T(", p99 ") + String(_inputLatency.getPercentile(.99) / 1000., 2) +
+		T(" ms over ") + String(int(_inputLatency.getCount())) + T(" moves"), x, y + 64);
+}
+
+const String SakuraMatrix::getInputLatencyReport() const
+{
+	String report;
+
+	report << T("input to paint, ") << String(int(_inputLatency.getCount())) << T(" moves\n");
+	report << T("mean: ") << String(_inputLatency.getMean() / 1000., 3) << T(" ms\n");
+
+	const double fractions[] = { .5, .9, .99, .999 };
+	const char *names[] = { "p50", "p90", "p99", "p99.9" };
+
+	for(int idx = 0; idx < 4; idx++)
+		report << names[idx] << T(": ") << String(_inputLatency.getPercentile(fractions[idx]) / 1000., 3) << T(" ms\n");
+
+	report << T("max: ") << String(_inputLatency.getMax() / 1000., 3) << T(" ms\n");
+
+	return report;
 }
 
 void SakuraMatrix::resized()
@@ -369,7 +306,8 @@ void SakuraMatrix::resized()
 
 void SakuraMatrix::generateBackground()
 {
-	int width = _cellSize * _numberOfCellsX + (_cellSize * 2);
+	SAKURA_TRACE_SCOPE("generateBackground");
+
 	int bkWidth = getWidth();
 	int height = getHeight();
 
@@ -377,154 +315,770 @@ void SakuraMatrix::generateBackground()
 	_pBackImage = new Image(Image::RGB, bkWidth, height, false);
 
 	Graphics g(*_pBackImage);
-	GradientBrush mbrush(Colours::skyblue, 0, 0, Colour(0xffffea95), 0, height, false);
-	g.setBrush(&mbrush);
-	g.fillAll();
 
-	GradientBrush dividerBrush(Colours::skyblue, 0, height, Colour(0xffffea95), .0f, 0.f, false);
-	g.setBrush(&dividerBrush);
-	g.fillRect(width, 0, 1, height);
+	_renderer.paintBackground(g, _visibleCellsX, _visibleCellsY, _iStatusBarHeight, bkWidth, height, false);
+}
 
-	Image im(Image::ARGB, bkWidth, height, true);
-	Graphics gg(im);
+void SakuraMatrix::buildMatrix(int x_cells, int y_cells, int cellSize, bool generate)
+{
+	if(x_cells < 3 || y_cells < 3 ||
+		(_numberOfCellsX == x_cells && _numberOfCellsY == y_cells && _cellSize == cellSize && _pSnapshot))
+		return;
 
-	_decor_side_right->drawWithin(gg, width - _cellSize, _cellSize, _cellSize, height - _cellSize - _iStatusBarHeight, RectanglePlacement::onlyReduceInSize);
-	_decor_side_left->drawWithin(gg, 0, 0, _cellSize, height - _cellSize - _iStatusBarHeight, RectanglePlacement::onlyReduceInSize);
-	_decor_side_bottom->drawWithin(gg, 0, height - _cellSize - _iStatusBarHeight, width - _cellSize, _cellSize, RectanglePlacement::onlyReduceInSize);
+	if(_cellSize != cellSize)
+		_zoomCellSize = cellSize;
 
-	_decor_conner_left->drawWithin(gg, 0, height - (_cellSize * 2) - _iStatusBarHeight, _cellSize * 2, _cellSize * 2, RectanglePlacement::onlyReduceInSize);
-	_decor_conner_right->drawWithin(gg, width - (_cellSize * 2), height - (_cellSize * 2) - _iStatusBarHeight, _cellSize * 2, _cellSize * 2, RectanglePlacement::onlyReduceInSize);
-	_decor_conner_left_top->drawWithin(gg, 0, 0, _cellSize * 2, _cellSize * 2, RectanglePlacement::onlyReduceInSize);
-	_decor_conner_right_top->drawWithin(gg, width - (_cellSize * 2), 0, _cellSize * 2, _cellSize * 2, RectanglePlacement::onlyReduceInSize);
+	_renderer.setCellSize(cellSize);
 
-	GradientBrush brush(Colours::cornsilk, _cellSize, _cellSize, Colour(0xffffea95), _cellSize, _numberOfCellsY * _cellSize, false);
-	gg.setBrush(&brush);
-	gg.fillRoundedRectangle(_cellSize, _cellSize, _numberOfCellsX * _cellSize, _numberOfCellsY * _cellSize, 10);
-	gg.setColour(Colours::yellowgreen.brighter());
-	gg.drawRoundedRectangle(_cellSize, _cellSize, _numberOfCellsX * _cellSize, _numberOfCellsY * _cellSize, 10, 1);
+	_cellSize = _tempCellSize = cellSize;
 
-	gg.setOpacity(.3f);
-	for(int x_ = 1; x_ < _numberOfCellsX; x_++)
-		gg.drawVerticalLine(_cellSize + (x_ * _cellSize), _cellSize, height - _cellSize - _iStatusBarHeight);
+	// the window never outgrows the screen, a larger board is scrolled in the viewport
+	const Rectangle screen(Desktop::getInstance().getMainMonitorArea());
 
-	for(int y_ = 1; y_ < _numberOfCellsY; y_++)
-		gg.drawHorizontalLine(_cellSize + (y_ * _cellSize), _cellSize, width - _cellSize);
+	_visibleCellsX = jlimit(3, x_cells, ((screen.getWidth() - 32) / _cellSize) - 2);
+	_visibleCellsY = jlimit(3, y_cells, ((screen.getHeight() - _iStatusBarHeight - 64) / _cellSize) - 2);
 
-	gg.setOpacity(1.f);
-	_decor_butterfly_left->drawWithin(gg, width - _cellSize - (_cellSize / 4), (_cellSize * 2) - (_cellSize / 4), _cellSize / 2, _cellSize / 2, RectanglePlacement::onlyReduceInSize);
+	int iWindowWidth = _cellSize * _visibleCellsX + (_cellSize * 2);
+	int iWindowHeight = _cellSize * _visibleCellsY + _iStatusBarHeight + (_cellSize * 2);
 
-	gg.setOpacity(.7f);
-	_decor_title->drawWithin(gg, 10, 10, width - 20, _cellSize - 20, RectanglePlacement::onlyIncreaseInSize);
+	centreWithSize(iWindowWidth + (_settingsVisible ? _settingsPanelWidth : 0), iWindowHeight);
+
+	_engine.cancelGeneration();
+	_engine.waitUntilIdle();
+
+	_board.resize(x_cells, y_cells);
+	publishBoard();
+
+	_pViewport->setBounds(_cellSize, _cellSize, _visibleCellsX * _cellSize, _visibleCellsY * _cellSize);
+	_pBoardView->resizeBoard(_zoomCellSize);
+	_pViewport->setViewPosition(0, 0);
+
+	_numberOfCellsX = _tempWidthInCells = x_cells;
+	_numberOfCellsY = _tempHeightInCells = y_cells;
 
-	DropShadowEffect eff;
-	eff.applyEffect(im, g);
+	if(_x_focus >= _numberOfCellsX || _y_focus >= _numberOfCellsY)
+		_x_focus = _y_focus = 0;
+
+	if(generate)
+		generateBranch();
+
+	_pStatusBar->setBounds(0, iWindowHeight - _iStatusBarHeight, iWindowWidth, _iStatusBarHeight);
+	_pSettingsPanel->setBounds(iWindowWidth, 0, _settingsPanelWidth, iWindowHeight);
+
+	repaint();
 }
 
-void SakuraMatrix::buildMatrix(int x_cells, int y_cells, int cellSize)
+void SakuraMatrix::getBoardState(BoardState &state)
 {
-	if(x_cells < 3 || y_cells < 3 ||
-		(_numberOfCellsX == x_cells && _numberOfCellsY == y_cells && _cellSize == cellSize && _matrix.size()))
-		return;
+	_engine.waitUntilIdle();
+
+	_board.getState(state);
+}
+
+bool SakuraMatrix::saveBoard(const File &file)
+{
+	BoardState state;
+	getBoardState(state);
+
+	return BoardStorage::save(file, state);
+}
+
+bool SakuraMatrix::loadBoard(const File &file)
+{
+	BoardStorage::Reader reader;
+
+	if(!reader.open(file))
+		return false;
+
+	_engine.cancelGeneration();
+	_engine.waitUntilIdle();
+
+	if(isTimerRunning(shuffleCommandId))
+		stopTimer(shuffleCommandId);
+
+	if(_peekMode)
+		setPeekMode(false);
+
+	buildMatrix(reader.header.width, reader.header.height, _cellSize, false);
+
+	_board.setState(reader.header, reader.pCells);
+	publishBoard();
+
+	_relaxMatrix = reader.header.relax;
+
+	_pBoardView->setDrawFocus(false);
+	forceRedrawAllCells();
+
+	_solved = false;
+	_x_focus = _y_focus = 0;
+
+	drawAlivePath();
 
-	if(_cellSize != cellSize || !SakuraMatrix::__figure_images.size())
+	if(!_board.getCellsOutOfPlace() && isAllCellsInPlace())
+		setAllCellsSolved();
+	else
+		if(_keyboardSupport)
+			_pBoardView->setFocus(0, 0, true);
+
+	repaintLiveCellsIfNeeded();
+
+	_recorder.recordLoad(_board);
+
+	_pRelaxMarixProperty->refresh();
+
+	return true;
+}
+
+bool SakuraMatrix::openPuzzlePack(const File &file)
+{
+	_puzzlePackPosition = 0;
+
+	if(!_puzzlePack.open(file) || !_puzzlePack.getNumPuzzles())
 	{
-		for(SakuraMatrix::FigureImagesType::iterator it = __figure_images.begin(), end = __figure_images.end(); it != end; it++)
-			for(sakura_map<int, Image*>::iterator it2 = (*it).second.begin(), end2 = (*it).second.end(); it2 != end2; it2++)
-				delete (*it2).second;
+		_puzzlePack.close();
+
+		_generateFromPack = false;
+		_pGenerateFromPackProperty->refresh();
+
+		return false;
+	}
 
-		__figure_images.clear();
+	_generateFromPack = true;
+	_pGenerateFromPackProperty->refresh();
 
-		Image *pTempImage = 0;
+	return true;
+}
+
+// Puts puzzle N of the opened pack on the board; the masks are read straight from the mapped pack.
+bool SakuraMatrix::loadPuzzle(int index)
+{
+	PuzzleRecord record;
+
+	if(!_puzzlePack.getPuzzle(index, record))
+		return false;
+
+	_engine.cancelGeneration();
+	_engine.waitUntilIdle();
+
+	if(_peekMode)
+		setPeekMode(false);
+
+	buildMatrix(record.width, record.height, _cellSize, false);
+
+	_board.setPuzzle(record);
+	publishBoard();
+
+	_pBoardView->setDrawFocus(false);
+	forceRedrawAllCells();
+
+	_recorder.recordLoad(_board);
+
+	startBranch();
+
+	return true;
+}
 
-		for(SakuraMatrix::FiguresType::iterator it = SakuraMatrix::__figures.begin(), end = SakuraMatrix::__figures.end(); it != end; ++it)
+void SakuraMatrix::generate()
+{
+	if(_generateFromPack && _puzzlePack.isOpen())
+	{
+		if(loadPuzzle(_puzzlePackPosition))
 		{
-			for(sakura_map<int, Drawable*>::iterator it2 = (*it).second.begin(), end2 = (*it).second.end(); it2 != end2; ++it2)
+			_puzzlePackPosition = (_puzzlePackPosition + 1) % _puzzlePack.getNumPuzzles();
+
+			return;
+		}
+	}
+
+	generateBranch();
+}
+
+void SakuraMatrix::engineResult(EngineResult &result)
+{
+	SAKURA_TRACE_SCOPE_ARG("engineResult", result.command.commandId);
+
+	_boardMemory = result.boardMemory;
+
+	switch(result.command.commandId)
+	{
+		case generateCommandId:
+			if(result.cancelled)
+				break;
+
+			_recorder.recordGenerate(result.pSnapshot->getWidth(), result.pSnapshot->getHeight(), result.rootX, result.rootY, result.command.infiniteMode, result.command.relax, result.command.seed);
+
+			showSnapshot(result.pSnapshot);
+			forceRedrawAllCells();
+
+			startBranch();
+			break;
+
+		case shuffleCommandId:
+			_recorder.recordShuffle(result.command.seed);
+
+			showShuffle(result);
+			break;
+
+		case rotateLeftCommandId:
+			if(result.cellIndex >= 0)
 			{
-				pTempImage = new Image(Image::ARGB, cellSize, cellSize, true);
-				Graphics g(*pTempImage);
+				_recorder.recordRotate(result.cellIndex, result.leftTurns);
+
+				showMove(result);
 
-				(*it2).second->drawWithin(g, 0, 0, pTempImage->getWidth(), pTempImage->getHeight(), RectanglePlacement::stretchToFit);
-				SakuraMatrix::__figure_images[(*it).first][(*it2).first] = pTempImage;
+				_pBoardView->startRotation(result.cellIndex, result.leftTurns);
+				startAnimationClock();
 			}
+			break;
+
+		case hintCommandId:
+			if(result.cellIndex < 0)
+			{
+				_pStatusBar->setText(result.cancelled ? T("the hints are still being prepared") : T("no cell is forced yet"));
+				break;
+			}
+
+			_recorder.recordRotate(result.cellIndex, result.leftTurns);
+			_pStatusBar->setText(String::empty);
+
+			_x_focus = result.cellIndex % _numberOfCellsX;
+			_y_focus = result.cellIndex / _numberOfCellsX;
+
+			if(_keyboardSupport)
+				_pBoardView->setFocus(_x_focus, _y_focus, true);
+
+			scrollToFocus();
+			showMove(result);
+
+			_pBoardView->startRotation(result.cellIndex, result.leftTurns);
+			startAnimationClock();
+			break;
+
+		case undoCommandId:
+		case redoCommandId:
+			if(result.cellIndex >= 0)
+			{
+				if(result.command.commandId == undoCommandId)
+					_recorder.recordUndo();
+				else
+					_recorder.recordRedo();
+
+				_pBoardView->stopRotation(result.cellIndex);
+				showMove(result);
+			}
+			break;
+	}
+}
+
+void SakuraMatrix::showShuffle(EngineResult &result)
+{
+	std::vector<uint8> visibleMasks;
+
+	// the view still shows the board as it was before the shuffle
+	_pBoardView->getVisibleMasks(visibleMasks);
+
+	showSnapshot(result.pSnapshot);
+
+	forceRedrawAllCells();
+	repaintLiveCellsIfNeeded();
+
+	_pBoardView->animateTurns(visibleMasks);
+	startAnimationClock();
+
+	_x_focus = _y_focus = 0;
+
+	if(_keyboardSupport)
+	{
+		_pBoardView->setFocus(0, 0, true);
+		scrollToFocus();
+	}
+
+	_solved = false;
+}
+
+void SakuraMatrix::showMove(const EngineResult &result)
+{
+	SAKURA_PROFILE_SCOPE(repaint);
+
+	showSnapshot(result.pSnapshot);
+
+	_pBoardView->repaintCell(result.cellIndex);
+
+	markInput(result.command.inputTicks);
+
+	if(result.solved)
+	{
+		_pBoardView->setDrawFocus(false);
+
+		_solved = true;
+	}
+
+	if(result.solved || result.retraced)
+	{
+		repaintLiveCellsIfNeeded();
+
+		return;
+	}
+
+	for(std::vector<int>::const_iterator it = result.changedCells.begin(), end = result.changedCells.end(); it != end; ++it)
+		_pBoardView->repaintLiveIfNeeded(*it);
+}
+
+void SakuraMatrix::showHint()
+{
+	if(_solved)
+		return;
+
+	EngineCommand command(hintCommandId);
+	command.inputTicks = Time::getHighResolutionTicks();
+
+	postCommand(command);
+}
+
+void SakuraMatrix::undoMove()
+{
+	if(_solved)
+		return;
+
+	postCommand(EngineCommand(undoCommandId));
+}
+
+void SakuraMatrix::redoMove()
+{
+	if(_solved)
+		return;
+
+	postCommand(EngineCommand(redoCommandId));
+}
+
+namespace
+{
+	int rotateMaskLeft(int mask)
+	{
+		return ((mask >> 1) | ((mask & 1) << 3)) & 0x0f;
+	}
+}
+
+void BoardView::paint(Graphics &g)
+{
+	if(!_pBoard)
+		return;
+
+	int width = _pBoard->getWidth();
+	int height = _pBoard->getHeight();
+
+	if(!_cellSize || int(_paintedLive.size()) != width * height)
+		return;
+
+	const Rectangle clip(g.getClipBounds());
+	int left = jmax(0, clip.getX() / _cellSize);
+	int top = jmax(0, clip.getY() / _cellSize);
+	int right = jmin(width, (clip.getRight() + _cellSize - 1) / _cellSize);
+	int bottom = jmin(height, (clip.getBottom() + _cellSize - 1) / _cellSize);
+
+	if(clip.isEmpty())
+		return;
+
+	SAKURA_TRACE_SCOPE_ARG("paintCells", (right - left) * (bottom - top));
+
+	// a frame is a paint of the view; the matrix behind it isn't painted for the cells that change
+	SAKURA_PROFILE_BEGIN_FRAME(_pParentComponent->isCountedFrame(this, clip));
+
+	if(!_pFrame || _pFrame->getWidth() < clip.getWidth() || _pFrame->getHeight() < clip.getHeight())
+	{
+		int frameWidth = _pFrame ? jmax(clip.getWidth(), _pFrame->getWidth()) : clip.getWidth();
+		int frameHeight = _pFrame ? jmax(clip.getHeight(), _pFrame->getHeight()) : clip.getHeight();
+
+		delete _pFrame;
+		_pFrame = new Image(Image::ARGB, frameWidth, frameHeight, false);
+	}
+
+	fillBackground(clip);
+
+	BoardRenderer &renderer = _pParentComponent->getRenderer();
+	bool figures = BoardRenderer::needsFigures(_cellSize);
+
+	// the cell size figures go through the blit kernel, the zoomed ones have to be scaled by the frame graphics
+	bool blit = (_cellSize == renderer.getCellSize());
+	uint32 now = Time::getMillisecondCounter();
+
+	{
+		Graphics frame(*_pFrame);
+
+		frame.setOrigin(-clip.getX(), -clip.getY());
+
+		// the grid would only cover small cells up
+		if(figures)
+		{
+			frame.setColour(Colours::yellowgreen.brighter().withAlpha(.3f));
+
+			for(int x = jmax(left, 1); x < right; x++)
+				frame.drawVerticalLine(x * _cellSize, float(top * _cellSize), float(bottom * _cellSize));
+
+			for(int y = jmax(top, 1); y < bottom; y++)
+				frame.drawHorizontalLine(y * _cellSize, float(left * _cellSize), float(right * _cellSize));
 		}
+
+		for(int y = top; y < bottom; y++)
+			for(int x = left; x < right; x++)
+			{
+				SAKURA_PROFILE_PAINTED_CELL();
+
+				int cellIndex = (y * width) + x;
+				int live = _pBoard->getLive(x, y);
+				_paintedLive[cellIndex] = uint8(live);
+
+				if(!figures)
+					continue;
+
+				AnimationsType::const_iterator animation = _animations.empty() ? _animations.end() : _animations.find(cellIndex);
+				int angle = (animation != _animations.end() && !_drawOriginal) ? getRotationAngle(animation->second, now) : -1;
+
+				if(angle < 0)
+				{
+					if(blit)
+						renderer.blitCell(*_pFrame, (x * _cellSize) - clip.getX(), (y * _cellSize) - clip.getY(), _pBoard->getCell(x, y), live, _drawOriginal);
+					else
+						renderer.paintZoomedCell(frame, x * _cellSize, y * _cellSize, _cellSize, _pBoard->getCell(x, y), live, _drawOriginal, false);
+
+					continue;
+				}
+
+				int mask = animation->second.startMask;
+
+				for(int turns = angle / BoardRenderer::rotationFrames; turns; turns--)
+					mask = rotateMaskLeft(mask);
+
+				if(blit)
+					renderer.blitRotatingCell(*_pFrame, (x * _cellSize) - clip.getX(), (y * _cellSize) - clip.getY(), mask, live, angle % BoardRenderer::rotationFrames);
+				else
+					renderer.paintRotatingCell(frame, x * _cellSize, y * _cellSize, _cellSize, mask, live, angle % BoardRenderer::rotationFrames, false);
+			}
+
+		if(BoardRenderer::needsLod(_cellSize))
+			renderer.paintLodCells(frame, *_pBoard, left, top, right, bottom, _cellSize, _drawOriginal);
 	}
 
-	_numberOfCellsX = _tempWidthInCells = x_cells;
-	_numberOfCellsY = _tempHeightInCells = y_cells;
-	_cellSize = _tempCellSize = cellSize;
+	g.drawImage(_pFrame, clip.getX(), clip.getY(), clip.getWidth(), clip.getHeight(), 0, 0, clip.getWidth(), clip.getHeight(), false);
 
-	int iWindowWidth = _cellSize * _numberOfCellsX + (_cellSize * 2);
-	int iWindowHeight = _cellSize * _numberOfCellsY + _iStatusBarHeight + (_cellSize * 2);
+	if(_drawFocus)
+	{
+		g.setColour(Colours::crimson);
+		g.drawRect(_x_focus * _cellSize, _y_focus * _cellSize, _cellSize, _cellSize);
+	}
 
-	centreWithSize(iWindowWidth + (_settingsVisible ? _settingsPanelWidth : 0), iWindowHeight);
+	SAKURA_PROFILE_END_FRAME();
+
+	_pParentComponent->framePainted();
+}
 
-	clear();
+// The gradient the board frame used to show under the cells, fixed to the viewport rather than to the scrolled board.
+void BoardView::fillBackground(const Rectangle &clip)
+{
+	const Component *pHolder = getParentComponent();
+	int range = jmax(1, pHolder ? pHolder->getHeight() : getHeight());
+	uint32 from = Colours::cornsilk.getARGB();
+	uint32 to = 0xffffea95;
 
-	int index = 0;
-	int x = 0;
-	int y = 0;
-	_matrix.resize(_numberOfCellsY);
-	for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
+	int lineStride = 0;
+	int pixelStride = 0;
+	uint8 *pPixels = _pFrame->lockPixelDataReadWrite(0, 0, clip.getWidth(), clip.getHeight(), lineStride, pixelStride);
+
+	for(int row = 0; row < clip.getHeight(); row++)
 	{
-		(*it).resize(_numberOfCellsX);
-		for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
+		int position = jlimit(0, range, clip.getY() + row + getY());
+		uint32 colour = 0;
+
+		for(int shift = 0; shift < 32; shift += 8)
 		{
-			(*it2) = new CellComponent(this);
-			addAndMakeVisible((*it2));
+			int fromChannel = int((from >> shift) & 0xff);
+			int toChannel = int((to >> shift) & 0xff);
 
-			x = index % _numberOfCellsX; y = index / _numberOfCellsX;
-			(*it2)->setBounds(_cellSize + (x * _cellSize), _cellSize + (y * _cellSize), _cellSize, _cellSize);
-			index++;
+			colour |= uint32(fromChannel + (((toChannel - fromChannel) * position) / range)) << shift;
 		}
+
+		PixelBlitter::fillRow(reinterpret_cast<uint32*>(pPixels + (row * lineStride)), colour, clip.getWidth());
 	}
 
-	generateBranch();
+	_pFrame->releasePixelDataReadWrite(pPixels);
+}
 
-	_pStatusBar->setBounds(0, iWindowHeight - _iStatusBarHeight, iWindowWidth, _iStatusBarHeight);
-	_pSettingsPanel->setBounds(iWindowWidth, 0, _settingsPanelWidth, iWindowHeight);
+void BoardView::repaintLiveCellsIfNeeded()
+{
+	if(!_cellSize)
+		return;
+
+	int width = _pBoard->getWidth();
+	int left, top, right, bottom;
+
+	getVisibleCells(left, top, right, bottom);
+
+	if(!BoardRenderer::needsLod(_cellSize))
+	{
+		for(int y = top; y < bottom; y++)
+			for(int x = left; x < right; x++)
+				repaintLiveIfNeeded((y * width) + x);
+
+		return;
+	}
+
+	// a zoomed out view may show a million cells: one rectangle around the changed ones is cheaper than a rectangle each
+	int changedLeft = right;
+	int changedTop = bottom;
+	int changedRight = 0;
+	int changedBottom = 0;
+
+	for(int y = top; y < bottom; y++)
+		for(int x = left; x < right; x++)
+			if(_pBoard->getLive(x, y) != _paintedLive[(y * width) + x])
+			{
+				changedLeft = jmin(changedLeft, x);
+				changedTop = jmin(changedTop, y);
+				changedRight = jmax(changedRight, x + 1);
+				changedBottom = jmax(changedBottom, y + 1);
+			}
+
+	if(changedLeft < changedRight)
+		repaint(changedLeft * _cellSize, changedTop * _cellSize, (changedRight - changedLeft) * _cellSize, (changedBottom - changedTop) * _cellSize);
 }
 
-void CellComponent::paint(Graphics &g)
+void BoardView::getVisibleCells(int &left, int &top, int &right, int &bottom) const
 {
-	g.fillAll(Colours::transparentWhite);
-	g.drawImageAt(SakuraMatrix::__figure_images[to_string(_drawOriginal)][_drawOriginal ? _drawOriginal : _live], 0, 0, false);
+	const Rectangle visible(getVisibleArea());
 
-	if(_drawFocus)
+	left = top = right = bottom = 0;
+
+	if(!_cellSize)
+		return;
+
+	left = visible.getX() / _cellSize;
+	top = visible.getY() / _cellSize;
+	right = jmin(_pBoard->getWidth(), (visible.getRight() + _cellSize - 1) / _cellSize);
+	bottom = jmin(_pBoard->getHeight(), (visible.getBottom() + _cellSize - 1) / _cellSize);
+}
+
+int BoardView::getRotationAngle(const CellAnimation &animation, uint32 now)
+{
+	// three quarters to the left are shown as the quarter to the right they amount to
+	bool clockwise = (animation.leftTurns == 3);
+	int quarters = clockwise ? 1 : animation.leftTurns;
+	uint32 elapsed = now - animation.start;
+
+	if(elapsed >= uint32(quarters * quarterTurnMilliseconds))
+		return -1;
+
+	int steps = int((elapsed * BoardRenderer::rotationFrames) / quarterTurnMilliseconds);
+
+	return clockwise ? ((4 * BoardRenderer::rotationFrames) - steps) % (4 * BoardRenderer::rotationFrames) : steps;
+}
+
+void BoardView::startRotation(int cellIndex, int leftTurns)
+{
+	leftTurns &= 3;
+
+	if(!leftTurns || _drawOriginal || !BoardRenderer::needsFigures(_cellSize))
+		return;
+
+	int width = _pBoard->getWidth();
+	int x = cellIndex % width;
+	int y = cellIndex / width;
+
+	if(!getVisibleArea().intersects(Rectangle(x * _cellSize, y * _cellSize, _cellSize, _cellSize)))
+		return;
+
+	// the board has already turned the cell, the turn starts from where it was
+	int mask = _pBoard->getCell(x, y).getMask();
+
+	for(int turns = leftTurns; turns < 4; turns++)
+		mask = rotateMaskLeft(mask);
+
+	// the repaint below shows angle 0
+	CellAnimation animation = { mask, leftTurns, Time::getMillisecondCounter(), 0 };
+
+	_animations[cellIndex] = animation;
+
+	repaintCell(cellIndex);
+}
+
+bool BoardView::advanceAnimations()
+{
+	uint32 now = Time::getMillisecondCounter();
+	int width = _pBoard->getWidth();
+
+	// a shuffle turns every visible cell at once, so their repaints are merged into one rectangle
+	bool merge = (_animations.size() > 32);
+	int changedLeft = width;
+	int changedTop = _pBoard->getHeight();
+	int changedRight = 0;
+	int changedBottom = 0;
+
+	for(AnimationsType::iterator it = _animations.begin(); it != _animations.end();)
 	{
-		g.setColour(Colours::crimson);
-		g.drawRect(0, 0, getWidth(), getHeight());
+		int cellIndex = it->first;
+		int angle = getRotationAngle(it->second, now);
+
+		if(angle != it->second.shownAngle)
+		{
+			it->second.shownAngle = angle;
+
+			if(merge)
+			{
+				changedLeft = jmin(changedLeft, cellIndex % width);
+				changedTop = jmin(changedTop, cellIndex / width);
+				changedRight = jmax(changedRight, (cellIndex % width) + 1);
+				changedBottom = jmax(changedBottom, (cellIndex / width) + 1);
+			}
+			else
+				repaintCell(cellIndex);
+		}
+
+		if(angle < 0)
+			_animations.erase(it++);
+		else
+			++it;
 	}
+
+	if(changedLeft < changedRight)
+		repaint(changedLeft * _cellSize, changedTop * _cellSize, (changedRight - changedLeft) * _cellSize, (changedBottom - changedTop) * _cellSize);
+
+	return !_animations.empty();
 }
 
-void CellComponent::resized()
+void BoardView::getVisibleMasks(std::vector<uint8> &masks) const
 {
+	int left, top, right, bottom;
+
+	masks.clear();
+
+	if(_drawOriginal || !BoardRenderer::needsFigures(_cellSize))
+		return;
+
+	getVisibleCells(left, top, right, bottom);
+
+	for(int y = top; y < bottom; y++)
+		for(int x = left; x < right; x++)
+			masks.push_back(uint8(_pBoard->getCell(x, y).getMask()));
 }
 
+void BoardView::animateTurns(const std::vector<uint8> &masks)
+{
+	int left, top, right, bottom;
+
+	getVisibleCells(left, top, right, bottom);
+
+	if(masks.empty() || int(masks.size()) != (right - left) * (bottom - top))
+		return;
+
+	std::vector<uint8>::const_iterator it = masks.begin();
 
-void CellComponent::timerCallback()
+	for(int y = top; y < bottom; y++)
+		for(int x = left; x < right; x++, ++it)
+		{
+			int mask = *it;
+			int leftTurns = 0;
+
+			while(leftTurns < 4 && mask != _pBoard->getCell(x, y).getMask())
+			{
+				mask = rotateMaskLeft(mask);
+				leftTurns++;
+			}
+
+			if(leftTurns & 3)
+				startRotation((y * _pBoard->getWidth()) + x, leftTurns);
+		}
+}
+
+void BoardView::mouseDown(const MouseEvent &e)
 {
+	int cellIndex = getCellIndexAt(e.x, e.y);
+
+	if(cellIndex < 0 || _pParentComponent->isAlreadySolved())
+		return;
+
+	_pParentComponent->rotateCell(cellIndex, _pParentComponent->isMouseButtonsDirectionsSwapped() ? !e.mods.isLeftButtonDown() : e.mods.isLeftButtonDown(), e.mods.isMiddleButtonDown());
 }
 
-void CellComponent::mouseDown(const MouseEvent &e)
+void BoardView::mouseWheelMove(const MouseEvent &e, float x, float y)
 {
-	if(_pParentComponent->isAlreadySolved())
+	// ctrl zooms around the pointer, shift leaves the wheel to the viewport to scroll the board
+	if(e.mods.isCommandDown())
+	{
+		_pParentComponent->zoomBoard(x > 0 || y > 0, e.x, e.y);
 		return;
+	}
 
-	_pParentComponent->rotateCell(this, _pParentComponent->isMouseButtonsDirectionsSwapped() ? !e.mods.isLeftButtonDown() : e.mods.isLeftButtonDown(), e.mods.isMiddleButtonDown());
+	if(e.mods.isShiftDown())
+	{
+		Component::mouseWheelMove(e, x, y);
+		return;
+	}
+
+	int cellIndex = getCellIndexAt(e.x, e.y);
+
+	if(cellIndex < 0 || _pParentComponent->isAlreadySolved())
+		return;
+
+	_pParentComponent->rotateCell(cellIndex, _pParentComponent->isMouseWheelDirectionsSwapped() ? !(x > 0 || y > 0) : (x > 0 || y > 0));
 }
 
-void CellComponent::mouseWheelMove(const MouseEvent &, float x, float y)
+void SakuraMatrix::zoomBoard(bool zoomIn, int x, int y)
 {
-	if(_pParentComponent->isAlreadySolved())
+	int cellSize = zoomIn ? jmin(256, _zoomCellSize + jmax(1, _zoomCellSize / 4)) : jmax(1, _zoomCellSize - jmax(1, _zoomCellSize / 5));
+
+	// the steps stop at the cell size, the only size drawn without scaling
+	if((_zoomCellSize - _cellSize) * (cellSize - _cellSize) < 0)
+		cellSize = _cellSize;
+
+	if(cellSize == _zoomCellSize)
 		return;
 
-	_pParentComponent->rotateCell(this, _pParentComponent->isMouseWheelDirectionsSwapped() ? !(x > 0 || y > 0) : (x > 0 || y > 0));
+	int viewX = x - _pViewport->getViewPositionX();
+	int viewY = y - _pViewport->getViewPositionY();
+
+	x = int((int64(x) * cellSize) / _zoomCellSize);
+	y = int((int64(y) * cellSize) / _zoomCellSize);
+
+	_zoomCellSize = cellSize;
+	_pBoardView->setCellSize(cellSize);
+
+	scrollBoardTo(x - viewX, y - viewY);
+}
+
+void SakuraMatrix::scrollBoardTo(int x, int y)
+{
+	x = jlimit(0, jmax(0, _pBoardView->getWidth() - _pViewport->getMaximumVisibleWidth()), x);
+	y = jlimit(0, jmax(0, _pBoardView->getHeight() - _pViewport->getMaximumVisibleHeight()), y);
+
+	_pViewport->setViewPosition(x, y);
+}
+
+void SakuraMatrix::scrollToFocus()
+{
+	int cellSize = _pBoardView->getCellSize();
+	int left = _x_focus * cellSize;
+	int top = _y_focus * cellSize;
+	int x = _pViewport->getViewPositionX();
+	int y = _pViewport->getViewPositionY();
+
+	if(left < x)
+		x = left;
+	else
+		if(left + cellSize > x + _pViewport->getViewWidth())
+			x = left + cellSize - _pViewport->getViewWidth();
+
+	if(top < y)
+		y = top;
+	else
+		if(top + cellSize > y + _pViewport->getViewHeight())
+			y = top + cellSize - _pViewport->getViewHeight();
+
+	scrollBoardTo(x, y);
 }
 
 void StatusBarComponent::buttonClicked(Button *button)
 {
 	if(button == _pGenerateButton)
-		_pMatrix->generateBranch();
+		_pMatrix->generate();
 	else
 		if(button == _pShuffleButton)
 			_pMatrix->shuffleMatrix();
@@ -533,6 +1087,18 @@ void StatusBarComponent::buttonClicked(Button *button)
 				_pMatrix->toggleSettings();
 }
 
+void SakuraMatrix::toggleOverlay()
+{
+	_showOverlay = !_showOverlay;
+
+	if(_showOverlay)
+		startTimer(overlayTimerId, 250);
+	else
+		stopTimer(overlayTimerId);
+
+	repaintOverlay();
+}
+
 void SakuraMatrix::toggleSettings()
 {
 	if(_settingsVisible)
@@ -549,39 +1115,10 @@ void SakuraMatrix::toggleSettings()
 	}
 }
 
-bool SakuraMatrix::positionRoot()
-{
-	_x_root_cell = _numberOfCellsX / 2;
-	_y_root_cell = _numberOfCellsY / 2;
-
-	if(_matrix[_y_root_cell][_x_root_cell]->count() < 2)
-	{
-		for(int y_clip_top = _y_root_cell - ((_numberOfCellsY & 1) ? 0 : 1), y_clip_bottom = _y_root_cell,
-				x_clip_left = _x_root_cell - ((_numberOfCellsX & 1) ? 0 : 1), x_clip_right = _x_root_cell;
-				y_clip_top >= 0 && x_clip_left >= 0;
-				y_clip_top--, y_clip_bottom++, x_clip_left--, x_clip_right++)
-		{
-			for(int y_ = y_clip_top; y_ <= y_clip_bottom; y_++)
-			{
-				for(int x_ = x_clip_left; x_ <= x_clip_right; x_++)
-				{
-					if(_matrix[y_][x_]->count() >= 2)
-					{
-						_x_root_cell = x_;
-						_y_root_cell = y_;
-
-						return true;
-					}
-				}
-			}
-		}
-	}
-
-	return false;
-}
-
 bool SakuraMatrix::perform(const InvocationInfo &info)
 {
+	SAKURA_TRACE_SCOPE_ARG("perform", info.commandID);
+
 	bool commandProcessed = false;
 	bool moveFocus = false;
 	int direction = -1;
@@ -589,7 +1126,7 @@ bool SakuraMatrix::perform(const InvocationInfo &info)
 	switch(info.commandID)
 	{
 		case generateCommandId:
-			generateBranch();
+			generate();
 			repaint();
 
 			commandProcessed = true;
@@ -619,10 +1156,20 @@ bool SakuraMatrix::perform(const InvocationInfo &info)
 			}
 			break;
 
+		case hintCommandId:
+			showHint();
+
+			commandProcessed = true;
+			break;
+
 		case settingsCommandId:
 			toggleSettings();
 			break;
 
+		case overlayCommandId:
+			toggleOverlay();
+			break;
+
 		case keyboardMoveLeftCommandId:
 			if(_keyboardSupport && !_solved)
 			{
@@ -662,22 +1209,39 @@ bool SakuraMatrix::perform(const InvocationInfo &info)
 		case rotateLeftCommandId:
 			if(_keyboardSupport && !_solved)
 			{
-				rotateCell(_matrix[_y_focus][_x_focus], true);
+				rotateCell((_y_focus * _numberOfCellsX) + _x_focus, true);
 			}
 			break;
 
 		case rotateRightCommandId:
 			if(_keyboardSupport && !_solved)
 			{
-				rotateCell(_matrix[_y_focus][_x_focus], false);
+				rotateCell((_y_focus * _numberOfCellsX) + _x_focus, false);
 			}
 			break;
+
+		case undoCommandId:
+			undoMove();
+
+			commandProcessed = true;
+			break;
+
+		case redoCommandId:
+			redoMove();
+
+			commandProcessed = true;
+			break;
+
+		case zoomInCommandId:
+		case zoomOutCommandId:
+			zoomBoard(info.commandID == zoomInCommandId, _pViewport->getViewPositionX() + (_pViewport->getViewWidth() / 2), _pViewport->getViewPositionY() + (_pViewport->getViewHeight() / 2));
+
+			commandProcessed = true;
+			break;
 	}
 
 	if(moveFocus && direction >= 0)
 	{
-		_matrix[_y_focus][_x_focus]->setDrawFocus(false);
-
 		_x_focus += __delta[direction].first;
 		_y_focus += __delta[direction].second;
 
@@ -693,7 +1257,8 @@ bool SakuraMatrix::perform(const InvocationInfo &info)
 					if(_y_focus >= _numberOfCellsY)
 						_y_focus = 0;
 
-		_matrix[_y_focus][_x_focus]->setDrawFocus(true);
+		_pBoardView->setFocus(_x_focus, _y_focus, true);
+		scrollToFocus();
 
 		commandProcessed = true;
 	}
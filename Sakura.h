@@ -22,6 +22,13 @@
 
 #include "juce/juce_amalgamated.h"
 #include "version.h"
+#include "SakuraBoard.h"
+#include "SakuraEngine.h"
+#include "SakuraSession.h"
+#include "SakuraRender.h"
+#include "SakuraProfiling.h"
+#include "SakuraTrace.h"
+#include "SakuraHistogram.h"
 
 #include <iostream>
 #include <vector>
@@ -62,361 +69,142 @@ private:
 nullptr = {}; // and whose name is nullptr
 
 
-namespace Direction
-{
-	enum direction
-	{
-		Left = 0,
-		Top,
-		Right,
-		Bottom
-	};
-}
-
-typedef std::deque<bool> DirectionSetType;
+class SakuraMatrix;
 
-class CellDirections
+// Shows the board inside the matrix viewport. There is no component per cell: a paint only draws the cells
+// in its clip region and a click is mapped to its cell, so a frame costs the visible area whatever the board size.
+class BoardView : public Component
 {
 private:
 
-	DirectionSetType _directions;
-
-public:
-
-	CellDirections() : _directions(4, false)
-	{
-	}
-
-	CellDirections(const CellDirections &copy) : _directions(4, false)
-	{
-		std::copy(copy._directions.begin(), copy._directions.end(), _directions.begin());
-	}
-
-	CellDirections(const DirectionSetType &directionsCopy) : _directions(4, false)
-	{
-		std::copy(directionsCopy.begin(), directionsCopy.end(), _directions.begin());
-	}
-
-	CellDirections &operator = (const CellDirections &copy)
-	{
-		std::copy(copy._directions.begin(), copy._directions.end(), _directions.begin());
-
-		return *this;
-	}
-
-	DirectionSetType getDirections() const
-	{
-		return _directions;
-	}
-
-	void setDirection(int direction, const bool value)
-	{
-		_directions[direction] = value;
-	}
-
-	bool getDirection(int direction) const
-	{
-		return _directions[direction];
-	}
-
-	void rotate(const bool left = true)
-	{
-		std::rotate(_directions.begin(), ((left) ? _directions.begin() + 1 : _directions.end() - 1), _directions.end());
-	}
-
-	void reset()
-	{
-		std::fill(_directions.begin(), _directions.end(), false);
-	}
-
-	bool empty() const
-	{
-		return count(true) == 0;
-	}
-
-	bool notEmpty() const
-	{
-		return !empty();
-	}
-
-	int count(bool value = true) const
-	{
-		return std::count(_directions.begin(), _directions.end(), value);
-	}
-
-	std::string to_string()
-	{
-		std::stringstream s;
-
-		std::copy(_directions.begin(), _directions.end(), std::ostream_iterator<int>(s, ""));
-
-		return s.str();
-	}
-
-	bool operator == (const CellDirections &directions) const
-	{
-		return std::equal(_directions.begin(), _directions.end(), directions._directions.begin());
-	}
-
-	std::pair<int, int> getConnectionType() const
-	{
-		int type(int(std::count(_directions.begin(), _directions.end(), true)));
-		int sub_type(0); // straight
-
-		if(type == 2)
-		{
-			DirectionSetType connected1(2, true);
-			DirectionSetType connected2(2, false);
-
-			if(std::search(_directions.begin(), _directions.end(), connected1.begin(), connected1.end()) != _directions.end() ||
-				std::search(_directions.begin(), _directions.end(), connected2.begin(), connected1.end()) != _directions.end())
-				sub_type = 1; // gay
-		}
-
-		return std::pair<int, int>(type, sub_type);
-	}
-
-	std::string dump(bool add_end_of_line = false) const
-	{
-		std::stringstream s;
-		std::copy(_directions.begin(), _directions.end(), std::ostream_iterator<int>(s, ""));
+	SakuraMatrix *_pParentComponent;
+	const BoardSnapshot *_pBoard;
 
-		if(add_end_of_line)
-			s << std::endl;
+	// the live state every cell was painted with the last time it was visible
+	std::vector<uint8> _paintedLive;
 
-		return s.str();
-	}
+	int _cellSize;
+	int _x_focus;
+	int _y_focus;
+	bool _drawOriginal;
+	bool _drawFocus;
 
-	std::string dumpLevel(const int level)
+	// A turn being shown; the board already holds the turned cell.
+	struct CellAnimation
 	{
-		std::stringstream s;
-
-		if(empty())
-		{
-			s << "`" << "`" << "`";
-		}
-		else
-		{
-			switch(level)
-			{
-			case 0:
-				s << " " << (_directions[1] ? "*" : " ") << " ";
-				break;
+		int startMask;
+		int leftTurns;
+		uint32 start;
+		int shownAngle;
+	};
 
-			case 1:
-				s << (_directions[0] ? "*" : " ") << ((_directions[0] || _directions[1] || _directions[2] || _directions[3]) ? "*" : " ") << (_directions[2] ? "*" : " ");
-				break;
+	typedef sakura_map<int, CellAnimation> AnimationsType;
 
-			case 2:
-				s << " " << (_directions[3] ? "*" : " ") << " ";
-				break;
-			}
-		}
+	AnimationsType _animations;
 
-		return s.str();
-	}
-};
+	// the clip region is composited here and blitted to the screen in one go
+	Image *_pFrame;
 
-class Cell
-{
-protected:
+	void fillBackground(const Rectangle &clip);
 
-	CellDirections _originalState;
-	CellDirections _currentState;
+	// The angle from the starting figure, anticlockwise, in rotation frames; -1 once the turn is over.
+	static int getRotationAngle(const CellAnimation &animation, uint32 now);
 
 public:
 
-	Cell()
+	enum
 	{
-	}
-
-	DirectionSetType getDirections(bool original = false) const
-	{
-		if(original)
-			return _originalState.getDirections();
-
-		return _currentState.getDirections();
-	}
-
-	void putInPlace()
-	{
-		_currentState = _originalState;
-	}
-
-	bool isInPlace() const
-	{
-		return (_currentState == _originalState);
-	}
-
-	void rotate(bool left = true)
-	{
-		_currentState.rotate(left);
-	}
-
-	void reset()
-	{
-		_originalState.reset();
-		_currentState.reset();
-	}
-
-	void setDirection(int direction, const bool value)
-	{
-		_originalState.setDirection(direction, value);
-		_currentState.setDirection(direction, value);
-	}
-
-	void setDirection(int direction, const bool value, const bool original)
-	{
-		if(original)
-			_originalState.setDirection(direction, value);
-		else
-			_currentState.setDirection(direction, value);
-	}
-
-	bool getDirection(int direction, bool original = false) const
-	{
-		if(original)
-			return _originalState.getDirection(direction);
-
-		return _currentState.getDirection(direction);
-	}
+		quarterTurnMilliseconds = 150
+	};
 
-	std::pair<int, int> getConnectionType(bool original = false) const
+	BoardView(SakuraMatrix *pParentComponent) :
+		_pParentComponent(pParentComponent),
+		_pBoard(0),
+		_cellSize(0),
+		_x_focus(0),
+		_y_focus(0),
+		_drawOriginal(false),
+		_drawFocus(false),
+		_pFrame(0)
 	{
-		if(original)
-			return _originalState.getConnectionType();
-
-		return _currentState.getConnectionType();
+		setOpaque(true);
 	}
 
-	bool empty() const
+	~BoardView()
 	{
-		return _originalState.empty();
+		delete _pFrame;
 	}
 
-	bool notEmpty() const
-	{
-		return _originalState.notEmpty();
-	}
+	void paint(Graphics &g);
 
-	int count(bool original = false, bool value = true) const
+	// The snapshot to paint from; the caller repaints what changed.
+	void setBoard(const BoardSnapshot *pBoard)
 	{
-		if(original)
-			return _originalState.count(value);
-
-		return _currentState.count(value);
+		_pBoard = pBoard;
 	}
 
-	std::string to_string(bool original = false)
+	// Called once the board has its new size; every cell is painted afresh.
+	void resizeBoard(int cellSize)
 	{
-		if(original)
-			return _originalState.to_string();
+		_paintedLive.assign(_pBoard->getNumCells(), 0);
+		_animations.clear();
+		_cellSize = 0;
 
-		return _currentState.to_string();
+		setCellSize(cellSize);
 	}
 
-	std::string dump(bool add_end_of_line = false, bool original = false) const
+	void setCellSize(int cellSize)
 	{
-		if(original)
-			return _originalState.dump(add_end_of_line);
+		_cellSize = cellSize;
 
-		return _currentState.dump(add_end_of_line);
+		setSize(_pBoard->getWidth() * _cellSize, _pBoard->getHeight() * _cellSize);
+		repaint();
 	}
 
-	std::string dumpLevel(const int level, bool original = false)
+	int getCellSize() const
 	{
-		if(original)
-			return _originalState.dumpLevel(level);
-
-		return _currentState.dumpLevel(level);
+		return _cellSize;
 	}
-};
-
-class SakuraMatrix;
-
-class CellComponent : public Cell, public Component, public Timer
-{
-private:
-
-	typedef sakura_map<std::string, sakura_map<bool, Image*> > CellFiguresType;
-
-	int _live;
-	int _requested_live;
-	bool _force_redraw;
-	bool _drawOriginal;
-	bool _drawFocus;
 
-	SakuraMatrix *_pParentComponent;
-
-public:
-
-	enum CellState
+	// -1 outside the board.
+	int getCellIndexAt(int x, int y) const
 	{
-		Dead = 0,
-		Alive = 1,
-		Solved = 2
-	};
+		if(x < 0 || y < 0 || x >= getWidth() || y >= getHeight())
+			return -1;
 
-	CellComponent(SakuraMatrix *pParentComponent) :
-		_live(false),
-		_requested_live(false),
-		_force_redraw(false),
-		_drawOriginal(false),
-		_drawFocus(false),
-		_pParentComponent(pParentComponent)
-	{
+		return ((y / _cellSize) * _pBoard->getWidth()) + (x / _cellSize);
 	}
 
-	~CellComponent()
+	// The part of the board the viewport shows, in view coordinates.
+	const Rectangle getVisibleArea() const
 	{
-	}
+		const Component *pHolder = getParentComponent();
 
-	void paint(Graphics &g);
-	void resized();
+		if(!pHolder)
+			return Rectangle(0, 0, getWidth(), getHeight());
 
-	void setLive(int live)
-	{
-		_requested_live = live;
+		return Rectangle(-getX(), -getY(), pHolder->getWidth(), pHolder->getHeight()).getIntersection(Rectangle(0, 0, getWidth(), getHeight()));
 	}
 
-	int getLive() const
-	{
-		return _live;
-	}
+	// The cells from (left, top) to (right, bottom), exclusive, the viewport shows.
+	void getVisibleCells(int &left, int &top, int &right, int &bottom) const;
 
-	int getRequestedLive() const
+	// Cells out of sight are clipped away by the viewport, they are painted with their state once scrolled in.
+	void repaintCell(int cellIndex)
 	{
-		return _requested_live;
-	}
+		int width = _pBoard->getWidth();
 
-	void forceRedraw()
-	{
-		_force_redraw = true;
+		repaint((cellIndex % width) * _cellSize, (cellIndex / width) * _cellSize, _cellSize, _cellSize);
 	}
 
-	void repaintLiveIfNeeded()
+	void repaintLiveIfNeeded(int cellIndex)
 	{
-		if(_requested_live != _live || _force_redraw)
-		{
-			_live = _requested_live;
-			_force_redraw = false;
-			repaint();
-		}
+		if(_pBoard->getLive(cellIndex % _pBoard->getWidth(), cellIndex / _pBoard->getWidth()) != _paintedLive[cellIndex])
+			repaintCell(cellIndex);
 	}
 
-	void rotateRandomly()
-	{
-		bool left = (std::rand() % 2) == 0;
-		int count = std::rand() % 4;
-
-		if(!(count & 1) && !left)
-			count = (count + 1) % 4;
-
-		for(int idx = 0; idx < count; idx++)
-			rotate(left);
-
-        _force_redraw = true;
-	}
+	// Only looks at the visible cells.
+	void repaintLiveCellsIfNeeded();
 
 	void setDrawOriginal(bool original)
 	{
@@ -428,53 +216,58 @@ public:
 		}
 	}
 
-	void setDrawFocus(bool draw)
+	void setFocus(int x, int y, bool draw)
 	{
-		if(_drawFocus != draw)
-		{
-			_drawFocus = draw;
+		if(_drawFocus)
+			repaintCell((_y_focus * _pBoard->getWidth()) + _x_focus);
 
-			repaint();
-		}
+		_x_focus = x;
+		_y_focus = y;
+		_drawFocus = draw;
+
+		if(_drawFocus)
+			repaintCell((_y_focus * _pBoard->getWidth()) + _x_focus);
 	}
 
-	bool isFocusDrawn()
+	void setDrawFocus(bool draw)
 	{
-		return _drawFocus;
+		setFocus(_x_focus, _y_focus, draw);
 	}
 
-	void reset()
+	bool isFocusDrawn() const
 	{
-		_drawFocus = false;
-
-		Cell::reset();
+		return _drawFocus;
 	}
 
-	virtual void timerCallback();
-
-	virtual void mouseDown(const MouseEvent &);
-	virtual void mouseWheelMove(const MouseEvent &, float, float);
+	// Shows the turn of a visible cell; the shared animation clock has to call advanceAnimations() until it returns false.
+	// A small or peeked board isn't animated.
+	void startRotation(int cellIndex, int leftTurns);
 
-	/*void connectCells(const CellComponent *pLeftNeighbour, const CellComponent *pTopNeighbour, const CellComponent *pRightNeighbour, const CellComponent *pBottomNeighbour) const
+	void stopRotation(int cellIndex)
 	{
-		_neighbours[int(Direction::Left)] = pLeftNeighbour;
-		_neighbours[int(Direction::Top)] = pTopNeighbour;
-		_neighbours[int(Direction::Right)] = pRightNeighbour;
-		_neighbours[int(Direction::Bottom)] = pBottomNeighbour;
+		if(_animations.erase(cellIndex))
+			repaintCell(cellIndex);
 	}
 
-	const CellComponent &connectCell(int direction, const CellComponent *pNeighbour) const
+	void stopAnimations()
 	{
-		_neighbours[direction] = pNeighbour;
-
-		return *this;
+		_animations.clear();
 	}
 
-	void interconnectCells(int direction, const CellComponent *pNeighbour) const
+	bool isAnimating() const
 	{
-		pNeighbour->connectCell(direction, this);
-		_neighbours[(direction + 2) % 4] = pNeighbour;
-	}*/
+		return !_animations.empty();
+	}
+
+	// One tick of the animation clock: repaints the cells whose frame has changed and drops the finished turns.
+	bool advanceAnimations();
+
+	// The masks of the visible cells row by row, taken before a shuffle so animateTurns() can turn them into their new places.
+	void getVisibleMasks(std::vector<uint8> &masks) const;
+	void animateTurns(const std::vector<uint8> &masks);
+
+	virtual void mouseDown(const MouseEvent &);
+	virtual void mouseWheelMove(const MouseEvent &, float, float);
 };
 
 class StaticGradientComponent : public Component
@@ -911,36 +704,20 @@ public:
 	}
 };
 
-class SakuraMatrix : public Component, public MultiTimer, public ApplicationCommandTarget
+class SakuraMatrix : public Component, public MultiTimer, public ApplicationCommandTarget, public GameEngine::Listener
 {
 private:
 
-	typedef std::vector<CellComponent*> MatrixRowType;
-	typedef std::vector<MatrixRowType> MatrixType;
-	typedef MatrixRowType::iterator MatrixRowTypeIterator;
-	typedef MatrixType::iterator MatrixTypeIterator;
-	typedef std::set<std::pair<int, int> > CellsCoordsType;
-
-	enum TimerCommands
-	{
-		generateCommandId = 1000,
-		shuffleCommandId,
-		peekCommandId,
-		settingsCommandId,
-		keyboardMoveLeftCommandId,
-		keyboardMoveUpCommandId,
-		keyboardMoveRightCommandId,
-		keyboardMoveDownCommandId,
-		rotateLeftCommandId,
-		rotateRightCommandId
-	};
+	// the board belongs to the engine thread; the view shows the snapshot of the last result handled
+	SakuraBoard _board;
+	GameEngine _engine;
+	const BoardSnapshot *_pSnapshot;
+	size_t _boardMemory;
 
-	MatrixType _matrix;
+	Viewport *_pViewport;
+	BoardView *_pBoardView;
 
-	int _x_root_cell;
-	int _y_root_cell;
 	bool _infiniteMode;
-	bool _infiniteMode_current;
 	bool _solved;
 	bool _peekMode;
 	bool _autoShuffle;
@@ -952,9 +729,17 @@ private:
 	bool _keyboardSupport;
 	int _x_focus;
 	int _y_focus;
+	bool _firstFrameShown;
+	bool _showOverlay;
+
+	// input to the end of the paint that shows it, in microseconds
+	LatencyHistogram _inputLatency;
+	int64 _inputTicks;
+
+	SessionRecorder _recorder;
+	bool _recordSession;
 
 	static std::vector<std::pair<int, int> > __delta;
-	CellsCoordsType _forbiddenCells;
 
 	Image *_pBackImage;
 
@@ -965,17 +750,18 @@ private:
 	int _numberOfCellsX;
 	int _numberOfCellsY;
 	int _cellSize;
+
+	// the window is kept within the screen, so the viewport may show only a part of the board
+	int _visibleCellsX;
+	int _visibleCellsY;
+	int _zoomCellSize;
 	double _relaxMatrix;
 
-	Drawable *_decor_side_right;
-	Drawable *_decor_side_left;
-	Drawable *_decor_side_bottom;
-	Drawable *_decor_conner_left;
-	Drawable *_decor_conner_right;
-	Drawable *_decor_conner_left_top;
-	Drawable *_decor_conner_right_top;
-	Drawable *_decor_butterfly_left;
-	Drawable *_decor_title;
+	PuzzlePack _puzzlePack;
+	int _puzzlePackPosition;
+	bool _generateFromPack;
+
+	BoardRenderer _renderer;
 
 	int _tempWidthInCells;
 	int _tempHeightInCells;
@@ -994,29 +780,29 @@ private:
 	BooleanValuePropertyComponent<SakuraMatrix> *_pSwapMouseButtonsDirectionsProperty;
 	BooleanValuePropertyComponent<SakuraMatrix> *_pSwapMouseWheelDirectionsProperty;
 	BooleanValuePropertyComponent<SakuraMatrix> *_pKeyboardSupportProperty;
+	BooleanValuePropertyComponent<SakuraMatrix> *_pGenerateFromPackProperty;
+	ProxyButtonPropertyComponent<SakuraMatrix> *_pOpenPuzzlePackProperty;
+	BooleanValuePropertyComponent<SakuraMatrix> *_pRecordSessionProperty;
 
 	KeyMappingsPropertyComponent *_pKeyMappingsProperty;
 
-	void clear()
+	void reset()
 	{
-		for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
-			for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
-			{
-				removeChildComponent(*it2);
-
-				delete (*it2);
-			}
-
-		_matrix.clear();
+		_pBoardView->setDrawFocus(false);
 	}
 
-	void reset()
+	// One clock drives every turning cell.
+	void startAnimationClock()
 	{
-		for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
-			for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
-				(*it2)->reset();
+		if(_pBoardView->isAnimating() && !isTimerRunning(animationTimerId))
+			startTimer(animationTimerId, 15);
 	}
 
+	void scrollBoardTo(int x, int y);
+
+	// Scrolls the viewport just enough to show the focused cell.
+	void scrollToFocus();
+
 	void timerCallback (const int timerId)
 	{
 		switch(timerId)
@@ -1030,77 +816,109 @@ private:
 
 				break;
 			}
+
+			case overlayTimerId:
+			{
+				repaintOverlay();
+
+				break;
+			}
+
+			case animationTimerId:
+			{
+				if(!_pBoardView->advanceAnimations())
+					stopTimer(timerId);
+
+				break;
+			}
+
+			case generationTimerId:
+			{
+				showGenerationProgress();
+
+				break;
+			}
+
+			case loadOrnamentsTimerId:
+			{
+				stopTimer(timerId);
+
+				_renderer.loadOrnaments();
+
+				deleteAndZero(_pBackImage);
+				repaint();
+
+				break;
+			}
 		}
 	}
 
-	template<class value>
-	void wrapAround(value &a, value &b, value a_limit, value b_limit)
+	// The status bar follows a long generation until the engine has nothing left to do.
+	void showGenerationProgress()
 	{
-		if(a < 0)
-			a = a_limit;
+		int progress = _engine.getGenerationProgress();
+
+		if(progress >= 0)
+			_pStatusBar->setText(String(T("generating ")) + String(progress / 10) + T("%"));
 		else
-			if(a > a_limit)
-				a = 0;
-			else
-				if(b < 0)
-					b = b_limit;
-				else
-					b = 0;
-	}
+		{
+			_pStatusBar->setText(String::empty);
 
-	void setupLive(int x, int y, int fromDirection)
-	{
-		CellComponent *pCell = _matrix[y][x];
+			if(_engine.isIdle())
+				stopTimer(generationTimerId);
+		}
+	}
 
-		if(pCell->getRequestedLive() || pCell->empty())
-			return;
+	void showMove(const EngineResult &result);
+	void showShuffle(EngineResult &result);
 
-		DirectionSetType this_directions = pCell->getDirections(false);
+	// The view switches to the given version of the board and the engine may free the older ones.
+	void showSnapshot(const BoardSnapshot *pSnapshot)
+	{
+		_pSnapshot = pSnapshot;
+		_pBoardView->setBoard(pSnapshot);
 
-		int r_x = 0;
-		int r_y = 0;
-		int next_from_direction = -1;
+		_engine.releaseSnapshotsBefore(pSnapshot);
+	}
 
-		for(int direction = 0; direction < 4; direction++)
-		{
-			if(!this_directions[direction] || direction == fromDirection)
-				continue;
+	// A move posted far ahead of the engine is dropped, and the player is told so.
+	bool postCommand(const EngineCommand &command)
+	{
+		if(_engine.post(command))
+			return true;
 
-			r_x = x + __delta[direction].first;
-			r_y = y + __delta[direction].second;
+		_pStatusBar->setText(T("too many moves are waiting, the last one was dropped"));
 
-			if(r_x < 0 || r_y < 0 || r_x >= _numberOfCellsX || r_y >= _numberOfCellsY)
-			{
-				if(_infiniteMode_current)
-					wrapAround(r_x, r_y, _numberOfCellsX - 1, _numberOfCellsY - 1);
-				else
-					continue;
-			}
+		return false;
+	}
 
-			CellComponent *pNextCell = _matrix[r_y][r_x];
+	// After the board was changed here rather than by the engine.
+	void publishBoard()
+	{
+		showSnapshot(_engine.publishBoard());
 
-			next_from_direction = (direction + 2) % 4;
+		_boardMemory = _board.getMemoryUsage() + _engine.getSnapshotMemory();
+	}
 
-			if(!pNextCell->getDirection(next_from_direction))
-				continue;
+	// The performance overlay sits over the top-left corner of the board.
+	const Rectangle getOverlayBounds() const
+	{
+		return Rectangle(_cellSize + 4, _cellSize + 4, jmin(380, (_visibleCellsX * _cellSize) - 8), 96);
+	}
 
-			pCell->setLive(true);
+	void paintOverlay(Graphics &g);
 
-			setupLive(r_x, r_y, next_from_direction);
+	void repaintOverlay()
+	{
+		const Rectangle bounds(getOverlayBounds());
 
-			pNextCell->setLive(true);
-		}
+		repaint(bounds.getX(), bounds.getY(), bounds.getWidth(), bounds.getHeight());
 	}
 
 public:
 
-	typedef sakura_map<std::string, sakura_map<int, Drawable*> > FiguresType;
-	typedef sakura_map<std::string, sakura_map<int, Image*> > FigureImagesType;
-
-	static FigureImagesType __figure_images;
-	static FiguresType __figures;
-
 	void paint(Graphics &g);
+	void paintOverChildren(Graphics &g);
 	void resized();
 	void generateBackground();
 
@@ -1108,18 +926,30 @@ public:
 
 	~SakuraMatrix();
 
-	CellComponent *getCellAt(int x, int y)
+	BoardRenderer &getRenderer()
 	{
-		return _matrix[y][x];
+		return _renderer;
 	}
 
-	void buildMatrix(int x_cells, int y_cells, int cellSize);
+	// Zooms the board view in or out by one step, keeping the board point at (x, y) of the view where it is on the screen.
+	void zoomBoard(bool zoomIn, int x, int y);
+
+	void buildMatrix(int x_cells, int y_cells, int cellSize, bool generate = true);
+
+	void getBoardState(BoardState &state);
+	bool saveBoard(const File &file);
+	bool loadBoard(const File &file);
+
+	bool openPuzzlePack(const File &file);
+	bool loadPuzzle(int index);
+	void generate();
 
 	void setAllCellsLive(int live)
 	{
-		for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
-			for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
-				(*it2)->setLive(live);
+		_engine.waitUntilIdle();
+
+		_board.setAllCellsLive(live);
+		publishBoard();
 	}
 
 	void killAllCells()
@@ -1143,9 +973,9 @@ public:
 		{
 			_peekMode = _solved = mode;
 
-			for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
-				for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
-					(*it2)->setDrawOriginal(_peekMode);
+			_recorder.recordPeek(_peekMode);
+
+			_pBoardView->setDrawOriginal(_peekMode);
 		}
 	}
 
@@ -1159,45 +989,26 @@ public:
 		return _peekMode;
 	}
 
+	// The branch is shown once the engine has generated it; a generation still running is called off.
 	void generateBranch()
 	{
-		_infiniteMode_current = _infiniteMode;
-
 		reset();
 
-		_forbiddenCells.clear();
-		for(int idx = 0, count = int(((_numberOfCellsX * _numberOfCellsY) * _relaxMatrix) + .5) ; idx < count; idx++)
-			_forbiddenCells.insert(std::pair<int, int>(std::rand() % _numberOfCellsX, std::rand() % _numberOfCellsY));
-
-		_forbiddenCells.erase(std::pair<int, int>(_x_root_cell, _y_root_cell));
+		EngineCommand command(generateCommandId);
+		command.infiniteMode = _infiniteMode;
+		command.relax = _relaxMatrix;
+		command.seed = SakuraBoard::makeSeed();
 
-		int f_x = 0;
-		int f_y = 0;
-		for(std::set<std::pair<int, int> >::iterator it = _forbiddenCells.begin(), end = _forbiddenCells.end(); it != end; ++it)
-		{
-			f_x = std::abs(_x_root_cell - (*it).first);
-			f_y = std::abs(_y_root_cell - (*it).second);
-
-			if(f_x <= _numberOfCellsX / 2 && f_y <= _numberOfCellsY / 2)
-			{
-				std::set<std::pair<int, int> >::iterator it2 = it;
-				it2++;
-
-				_forbiddenCells.erase(it);
-
-				it = it2;
-
-				if(it == end)
-					break;
-			}
-		}
-
-		generateCell(std::rand() % _numberOfCellsX, std::rand() % _numberOfCellsY);
-
-		positionRoot();
+		if(!postCommand(command))
+			return;
 
-		enlivenAllCells();
+		if(!isTimerRunning(generationTimerId))
+			startTimer(generationTimerId, 100);
+	}
 
+	// Shows a freshly generated or loaded branch in its solved state and schedules the auto-shuffle.
+	void startBranch()
+	{
 		repaintLiveCellsIfNeeded();
 
 		_solved = true;
@@ -1214,98 +1025,47 @@ public:
 		}
 	}
 
-	bool positionRoot();
-
-	void generateCell(int x, int y)
-	{
-		CellComponent *pCell = _matrix[y][x];
-
-		int r_direction = 0;
-		int shift_start = std::rand() % 4;
-		int r_x = 0;
-		int r_y = 0;
-		int max_connections = 2;
-
-		for(int direction = 0; direction < 4 && max_connections; direction++)
-		{
-			r_direction = (direction + shift_start) % 4;
-
-			if(pCell->getDirection(r_direction))
-				continue;
-
-			r_x = x + __delta[r_direction].first;
-			r_y = y + __delta[r_direction].second;
-
-			if(r_x < 0 || r_y < 0 || r_x >= _numberOfCellsX || r_y >= _numberOfCellsY)
-			{
-				if(_infiniteMode_current)
-					wrapAround(r_x, r_y, _numberOfCellsX - 1, _numberOfCellsY - 1);
-				else
-					continue;
-			}
-
-			CellComponent *pNextCell = _matrix[r_y][r_x];
-
-			if(pNextCell->notEmpty() || _forbiddenCells.find(std::pair<int, int>(r_x, r_y)) != _forbiddenCells.end())
-				continue;
-
-			pCell->setDirection(r_direction, true);
-			pNextCell->setDirection((r_direction + 2) % 4, true);
-
-			max_connections--;
-
-			generateCell(r_x, r_y);
-		}
-	}
-
 	void drawAlivePath()
 	{
-		killAllCells();
+		_engine.waitUntilIdle();
 
-		setupLive(_x_root_cell, _y_root_cell, -1);
+		_board.drawAlivePath();
+		_board.clearChangedCells();
 
+		publishBoard();
 		repaintLiveCellsIfNeeded();
 	}
 
 	void repaintLiveCellsIfNeeded()
 	{
-		for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
-			for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
-				(*it2)->repaintLiveIfNeeded();
+		_pBoardView->repaintLiveCellsIfNeeded();
 	}
 
+	void forceRedrawAllCells()
+	{
+		_pBoardView->stopAnimations();
+		_pBoardView->repaint();
+	}
+
+	// The shuffled board is shown once the engine has turned its cells.
 	void shuffleMatrix()
 	{
+		SAKURA_TRACE_SCOPE("shuffleMatrix");
+
 		if(isTimerRunning(shuffleCommandId))
 			stopTimer(shuffleCommandId);
 
 		if(_peekMode)
 			setPeekMode(false);
 
-		for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
-			for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
-				(*it2)->rotateRandomly();
+		EngineCommand command(shuffleCommandId);
+		command.seed = SakuraBoard::makeSeed();
 
-		while(isAllCellsInPlace())
-			for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
-				for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
-					(*it2)->rotateRandomly();
-
-		drawAlivePath();
-
-
-		if(_keyboardSupport)
-		{
-			_matrix[_y_focus][_x_focus]->setDrawFocus(false);
-			_matrix[0][0]->setDrawFocus(true);
-		}
-
-		_x_focus = _y_focus = 0;
-
-		_solved = false;
+		postCommand(command);
 	}
 
 	void toggleSettings();
+	void toggleOverlay();
 
 	void setInfiniteMode(const bool infinite = true)
 	{
@@ -1319,10 +1079,10 @@ public:
 
 	bool isAllCellsInPlace()
 	{
-		for(MatrixTypeIterator it = _matrix.begin(), end = _matrix.end(); it != end; ++it)
-			for(MatrixRowTypeIterator it2 = (*it).begin(), end2 = (*it).end(); it2 != end2; ++it2)
-				if(!(*it2)->isInPlace())
-					return false;
+		_engine.waitUntilIdle();
+
+		if(!_board.isAllCellsInPlace())
+			return false;
 
 		return (_solved = true);
 	}
@@ -1359,34 +1119,83 @@ public:
 
 		if(property == _pKeyboardSupportProperty)
 			if(!_solved)
-				_matrix[_y_focus][_x_focus]->setDrawFocus(_keyboardSupport);
+				_pBoardView->setFocus(_x_focus, _y_focus, _keyboardSupport);
 
 		if(property == _pAutoShuffleModeProperty)
 		{
 			_pAutoShuffleMillisecondsProperty->setEnabled(_autoShuffle);
 		}
-	}
 
-	void rotateCell(CellComponent *component, bool left, bool putInPlace = false)
-	{
-		if(putInPlace)
-			component->putInPlace();
-		else
-			component->rotate(left);
+		if(property == _pOpenPuzzlePackProperty)
+		{
+			FileChooser chooser(T("Open a puzzle pack"), File::getSpecialLocation(File::userDocumentsDirectory), T("*.sakurapack"));
 
-		component->repaint();
+			if(chooser.browseForFileToOpen())
+				openPuzzlePack(chooser.getResult());
+		}
 
-		drawAlivePath();
+		if(property == _pGenerateFromPackProperty)
+		{
+			if(_generateFromPack && !_puzzlePack.isOpen())
+			{
+				_generateFromPack = false;
+				_pGenerateFromPackProperty->refresh();
+			}
+		}
 
-		if(isAllCellsInPlace())
+		if(property == _pRecordSessionProperty)
 		{
-			_matrix[_y_focus][_x_focus]->setDrawFocus(false);
+			if(_recordSession)
+			{
+				_engine.waitUntilIdle();
+
+				File sessions(File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile(T("Sakura")).getChildFile(T("sessions")));
 
-			setAllCellsSolved();
-			repaintLiveCellsIfNeeded();
+				if(!_recorder.start(sessions.getNonexistentChildFile(T("session"), T(".sakurasession"), false), _board))
+				{
+					_recordSession = false;
+					_pRecordSessionProperty->refresh();
+				}
+			}
+			else
+				_recorder.stop();
 		}
 	}
 
+	// The turn is shown once the engine has made the move.
+	// Called from the mouse and keyboard callbacks, so the clock starts at the JUCE event.
+	void rotateCell(int cellIndex, bool left, bool putInPlace = false)
+	{
+		EngineCommand command(rotateLeftCommandId, cellIndex, putInPlace ? 0 : (left ? 1 : 3));
+		command.inputTicks = Time::getHighResolutionTicks();
+
+		postCommand(command);
+	}
+
+	// The move of the input is on the board now, so the next paint shows it and stops the clock.
+	// Moves shown before the previous one is painted share its frame; the earliest input is kept.
+	void markInput(int64 inputTicks)
+	{
+		if(inputTicks && (!_inputTicks || inputTicks < _inputTicks))
+			_inputTicks = inputTicks;
+	}
+
+	const LatencyHistogram &getInputLatency() const
+	{
+		return _inputLatency;
+	}
+
+	const String getInputLatencyReport() const;
+
+	bool isCountedFrame(const Component *pComponent, const Rectangle &clip) const;
+	void framePainted();
+
+	void undoMove();
+	void redoMove();
+	void showHint();
+
+	void engineResult(EngineResult &result);
+
 	bool isMouseButtonsDirectionsSwapped()
 	{
 		return _swapMouseButtonsDirections;
@@ -1397,9 +1206,6 @@ public:
 		return _swapMouseWheelDirections;
 	}
 
-	void generateDecor();
-	void generateFigures();
-
 	ApplicationCommandTarget *getNextCommandTarget()
 	{
 		return findFirstTargetParentComponent();
@@ -1410,13 +1216,19 @@ public:
 		commands.add(CommandID(int(generateCommandId)));
 		commands.add(CommandID(int(shuffleCommandId)));
 		commands.add(CommandID(int(peekCommandId)));
+		commands.add(CommandID(int(hintCommandId)));
 		commands.add(CommandID(int(settingsCommandId)));
+		commands.add(CommandID(int(overlayCommandId)));
 		commands.add(CommandID(int(keyboardMoveLeftCommandId)));
 		commands.add(CommandID(int(keyboardMoveUpCommandId)));
 		commands.add(CommandID(int(keyboardMoveRightCommandId)));
 		commands.add(CommandID(int(keyboardMoveDownCommandId)));
 		commands.add(CommandID(int(rotateLeftCommandId)));
 		commands.add(CommandID(int(rotateRightCommandId)));
+		commands.add(CommandID(int(undoCommandId)));
+		commands.add(CommandID(int(redoCommandId)));
+		commands.add(CommandID(int(zoomInCommandId)));
+		commands.add(CommandID(int(zoomOutCommandId)));
 	}
 
 	void getCommandInfo(const CommandID commandID, ApplicationCommandInfo &result)
@@ -1427,7 +1239,7 @@ public:
 		switch(commandID)
 		{
 			case generateCommandId:
-				result.setInfo(T("generate"), T("generates a new branch to solve"), generalGroup, 0);
+				result.setInfo(T("generate"), T("generates a new branch to solve or takes the next puzzle from the opened pack"), generalGroup, 0);
 				result.addDefaultKeypress(KeyPress::insertKey, 0);
 				break;
 
@@ -1441,11 +1253,21 @@ public:
 				result.addDefaultKeypress(KeyPress::homeKey, 0);
 				break;
 
+			case hintCommandId:
+				result.setInfo(T("hint"), T("turns one cell the others already force into its place"), generalGroup, 0);
+				result.addDefaultKeypress(KeyPress::endKey, 0);
+				break;
+
 			case settingsCommandId:
 				result.setInfo(T("settings"), T("shows or hides the settings pane"), generalGroup, 0);
 				result.addDefaultKeypress(KeyPress::F12Key, 0);
 				break;
 
+			case overlayCommandId:
+				result.setInfo(T("performance overlay"), T("shows or hides the move, paint and memory counters"), generalGroup, 0);
+				result.addDefaultKeypress(KeyPress::F11Key, 0);
+				break;
+
 			case keyboardMoveLeftCommandId:
 				result.setInfo(T("move left"), T("steps the current focus left"), keyboardGroup, 0);
 				result.addDefaultKeypress(KeyPress::leftKey, 0);
@@ -1475,6 +1297,26 @@ public:
 				result.setInfo(T("rotate right"), T("rotates a cell to the right"), keyboardGroup, 0);
 				result.addDefaultKeypress(KeyPress::pageDownKey, 0);
 				break;
+
+			case undoCommandId:
+				result.setInfo(T("undo"), T("takes the last rotation back"), generalGroup, 0);
+				result.addDefaultKeypress(T('z'), ModifierKeys::commandModifier);
+				break;
+
+			case redoCommandId:
+				result.setInfo(T("redo"), T("repeats the last rotation taken back"), generalGroup, 0);
+				result.addDefaultKeypress(T('y'), ModifierKeys::commandModifier);
+				break;
+
+			case zoomInCommandId:
+				result.setInfo(T("zoom in"), T("makes the cells larger (or use the mouse wheel with ctrl)"), generalGroup, 0);
+				result.addDefaultKeypress(T('='), ModifierKeys::commandModifier);
+				break;
+
+			case zoomOutCommandId:
+				result.setInfo(T("zoom out"), T("makes the cells smaller, so more of a large board fits"), generalGroup, 0);
+				result.addDefaultKeypress(T('-'), ModifierKeys::commandModifier);
+				break;
 		}
 	}
 
@@ -1482,12 +1324,14 @@ public:
 
 	void dumpMatrix(bool original = false)
 	{
+		_engine.waitUntilIdle();
+
 		for(int i = 0; i < _numberOfCellsY; i++)
 		{
 			for(int idx = 0; idx < 3; idx++)
 			{
 				for(int ii = 0; ii < _numberOfCellsX; ii++)
-					std::cout << _matrix[i][ii]->dumpLevel(idx, original);
+					std::cout << _board.getCell(ii, i).dumpLevel(idx, original);
 
 				std::cout << std::endl;
 			}
@@ -1507,6 +1351,7 @@ private:
 public:
 
 	static ApplicationCommandManager *__pCommandManager;
+	static PhaseTimer __startupPhases;
 
 	MainWindow(const String &name, const Colour &backgroundColour, const int requiredButtons, const bool addToDesktop = true);
 
@@ -1515,6 +1360,11 @@ public:
 		setContentComponent(0, true);
 	}
 
+	SakuraMatrix *getMatrix() const
+	{
+		return _pContentWindow;
+	}
+
 	void closeButtonPressed()
 	{
 		JUCEApplication::getInstance()->systemRequestedQuit();
@@ -1525,7 +1375,12 @@ class Sakura : public JUCEApplication
 {
 private:
 
-	DocumentWindow *_pMainWindow;
+	MainWindow *_pMainWindow;
+
+	static const File getAutosaveFile()
+	{
+		return File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile(T("Sakura")).getChildFile(T("autosave.sakura"));
+	}
 
 public:
 
@@ -1534,18 +1389,40 @@ public:
     	std::srand(std::time(0));
     }
 
-    void initialise (const String&)
+    void initialise (const String &commandLine)
     {
+#ifdef SAKURA_TRACING
+    	// --trace records the session into trace.json next to the autosave
+    	if(commandLine.contains(T("--trace")))
+    		TraceLog::enable(getAutosaveFile().getSiblingFile(T("trace.json")));
+#endif
+
+    	MainWindow::__startupPhases.mark("juce initialisation");
+
     	String title(T("Sakura"));
     	title += String(T(" (")) + AutoVersion::FULLVERSION_STRING + String(T(" ")) + AutoVersion::STATUS + String(T(") "));
 
     	_pMainWindow = new MainWindow(title, Colours::cornsilk.withMultipliedAlpha(.99f), DocumentWindow::minimiseButton | DocumentWindow::closeButton, true);
+
+    	// loaded before the window is shown, so the first frame is already the saved board
+    	if(getAutosaveFile().existsAsFile())
+    		_pMainWindow->getMatrix()->loadBoard(getAutosaveFile());
+
+    	MainWindow::__startupPhases.mark("autosave");
+
     	_pMainWindow->setVisible(true);
+
+    	MainWindow::__startupPhases.mark("window");
     }
 
     void shutdown()
     {
+    	if(_pMainWindow && _pMainWindow->getMatrix()->getInputLatency().getCount())
+    		getAutosaveFile().getSiblingFile(T("latency.log")).replaceWithText(_pMainWindow->getMatrix()->getInputLatencyReport());
+
     	delete _pMainWindow;
+
+    	TraceLog::flush();
     }
 
     const String getApplicationName()
@@ -1564,6 +1441,9 @@ public:
 
 	void systemRequestedQuit()
 	{
+		if(_pMainWindow)
+			_pMainWindow->getMatrix()->saveBoard(getAutosaveFile());
+
 		JUCEApplication::systemRequestedQuit();
 	}
 };
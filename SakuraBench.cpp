@@ -0,0 +1,1383 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+// Console benchmarks for the board engine and the puzzle codec, built by the "Benchmark" target.
+//
+// Usage: SakuraBench [--filter=text] [--max-cells=count] [--out=file] [--baseline=file] [--tolerance=fraction]
+//                    [--replay=session]...
+//
+// Every benchmark runs over a sweep of board sizes, regular and infinite modes and relax values.
+// Painting is timed into offscreen images, with no window or display, over board and cell sizes:
+// the background, full frames, single dirty cells, peek toggles and solved boards.
+// Every recorded session given with --replay is played back as well, reporting the latency percentiles
+// of its moves, generations, shuffles and loads.
+// The results are written as JSON, one benchmark per line; given a baseline written by an earlier run,
+// the benchmarks that got slower than the tolerance allows (on average or at the 99th percentile),
+// or started allocating more, are reported and the exit code is 1.
+// The other liveness modes, and the moves that keep the live cells up to date, have to find the same live cells
+// as the flood fill on every swept board.
+// The blit kernel the build picked has to blend every row exactly as the plain C++ one does.
+// A pack of generated puzzles is written, mapped and read back, and every puzzle has to match the board it came from.
+// The steady state of play, turning cells, tracing the live branch and blitting the cells of a repaint,
+// must not allocate at all; a build that counts allocations fails the run when it does.
+
+#include "SakuraBoard.h"
+#include "SakuraCodec.h"
+#include "SakuraSession.h"
+#include "SakuraRender.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+namespace
+{
+	struct BenchmarkResult
+	{
+		std::string name;
+		int width;
+		int height;
+		bool infiniteMode;
+		double relax;
+		int64 iterations;
+		double nsPerOp;
+		double cellsPerSecond;
+		double allocsPerOp;
+		double bytesPerOp;
+		double p50Ns;
+		double p99Ns;
+		double maxNs;
+
+		BenchmarkResult() :
+			width(0),
+			height(0),
+			infiniteMode(false),
+			relax(.0),
+			iterations(0),
+			nsPerOp(.0),
+			cellsPerSecond(.0),
+			allocsPerOp(.0),
+			bytesPerOp(.0),
+			p50Ns(.0),
+			p99Ns(.0),
+			maxNs(.0)
+		{
+		}
+
+		std::string getKey() const
+		{
+			char key[256];
+			sprintf(key, "%s %dx%d %d %.3f", name.c_str(), width, height, infiniteMode ? 1 : 0, relax);
+
+			return key;
+		}
+	};
+
+	struct BenchmarkOptions
+	{
+		std::string filter;
+		std::string outputFile;
+		std::string baselineFile;
+		std::vector<std::string> sessionFiles;
+		double tolerance;
+		int maxCells;
+
+		BenchmarkOptions() :
+			tolerance(.1),
+			maxCells(2000 * 2000)
+		{
+		}
+	};
+
+	class BenchmarkReport
+	{
+	private:
+
+		std::vector<BenchmarkResult> _results;
+
+		static bool parse(const char *pLine, BenchmarkResult &result)
+		{
+			char name[128];
+			char infinite[8];
+			long long iterations = 0;
+
+			// the reports written before the percentiles were added end after bytes_per_op
+			int fields = sscanf(pLine, " { \"name\": \"%127[^\"]\", \"width\": %d, \"height\": %d, \"infinite\": %7[a-z], \"relax\": %lf, "
+				"\"iterations\": %lld, \"ns_per_op\": %lf, \"cells_per_second\": %lf, \"allocs_per_op\": %lf, \"bytes_per_op\": %lf, "
+				"\"p50_ns\": %lf, \"p99_ns\": %lf, \"max_ns\": %lf",
+				name, &result.width, &result.height, infinite, &result.relax, &iterations,
+				&result.nsPerOp, &result.cellsPerSecond, &result.allocsPerOp, &result.bytesPerOp,
+				&result.p50Ns, &result.p99Ns, &result.maxNs);
+
+			if(fields != 10 && fields != 13)
+				return false;
+
+			result.name = name;
+			result.infiniteMode = (strcmp(infinite, "true") == 0);
+			result.iterations = iterations;
+
+			return true;
+		}
+
+	public:
+
+		void add(const BenchmarkResult &result)
+		{
+			_results.push_back(result);
+
+			fprintf(stderr, "%-28s %5dx%-5d %s relax %.2f: %14.1f ns/op %14.0f cells/s %10.2f allocs/op",
+				result.name.c_str(), result.width, result.height, result.infiniteMode ? "torus  " : "regular",
+				result.relax, result.nsPerOp, result.cellsPerSecond, result.allocsPerOp);
+
+			if(result.maxNs > .0)
+				fprintf(stderr, " p50 %.0f p99 %.0f max %.0f ns", result.p50Ns, result.p99Ns, result.maxNs);
+
+			fprintf(stderr, "\n");
+		}
+
+		void write(FILE *pOut) const
+		{
+			fprintf(pOut, "{\n\t\"benchmarks\": [\n");
+
+			for(size_t idx = 0; idx < _results.size(); idx++)
+			{
+				const BenchmarkResult &result = _results[idx];
+
+				fprintf(pOut, "\t\t{ \"name\": \"%s\", \"width\": %d, \"height\": %d, \"infinite\": %s, \"relax\": %.3f, "
+					"\"iterations\": %lld, \"ns_per_op\": %.1f, \"cells_per_second\": %.1f, \"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f, "
+					"\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f }%s\n",
+					result.name.c_str(), result.width, result.height, result.infiniteMode ? "true" : "false",
+					result.relax, (long long)result.iterations, result.nsPerOp, result.cellsPerSecond, result.allocsPerOp, result.bytesPerOp,
+					result.p50Ns, result.p99Ns, result.maxNs, (idx + 1 < _results.size()) ? "," : "");
+			}
+
+			fprintf(pOut, "\t]\n}\n");
+		}
+
+		// Returns the number of regressions against a report written by an earlier run.
+		int compare(FILE *pBaseline, double tolerance) const
+		{
+			std::map<std::string, BenchmarkResult> baseline;
+			char line[1024];
+
+			while(fgets(line, sizeof(line), pBaseline))
+			{
+				BenchmarkResult result;
+
+				if(parse(line, result))
+					baseline[result.getKey()] = result;
+			}
+
+			int regressions = 0;
+
+			for(std::vector<BenchmarkResult>::const_iterator it = _results.begin(), end = _results.end(); it != end; ++it)
+			{
+				std::map<std::string, BenchmarkResult>::const_iterator found = baseline.find((*it).getKey());
+
+				if(found == baseline.end())
+					continue;
+
+				const BenchmarkResult &previous = (*found).second;
+
+				if((*it).nsPerOp > previous.nsPerOp * (1. + tolerance) || (*it).allocsPerOp > previous.allocsPerOp + .5 ||
+					(previous.p99Ns > .0 && (*it).p99Ns > previous.p99Ns * (1. + tolerance)))
+				{
+					fprintf(stderr, "regression: %s: %.1f -> %.1f ns/op, %.0f -> %.0f ns p99, %.2f -> %.2f allocs/op\n",
+						(*it).getKey().c_str(), previous.nsPerOp, (*it).nsPerOp, previous.p99Ns, (*it).p99Ns,
+						previous.allocsPerOp, (*it).allocsPerOp);
+
+					regressions++;
+				}
+			}
+
+			return regressions;
+		}
+	};
+
+	class BenchmarkRunner
+	{
+	private:
+
+		const BenchmarkOptions &_options;
+		BenchmarkReport &_report;
+		int _allocatingBenchmarks;
+
+		static bool isSteadyState(const char *name)
+		{
+			static const char *__names[] = { "directions/rotate", "board/turn_cell", "board/draw_alive_path", "blit/kernel" };
+
+			for(size_t idx = 0; idx < sizeof(__names) / sizeof(__names[0]); idx++)
+				if(!strncmp(name, __names[idx], strlen(__names[idx])))
+					return true;
+
+			return false;
+		}
+
+	public:
+
+		BenchmarkRunner(const BenchmarkOptions &options, BenchmarkReport &report) :
+			_options(options),
+			_report(report),
+			_allocatingBenchmarks(0)
+		{
+		}
+
+		int getAllocatingBenchmarks() const
+		{
+			return _allocatingBenchmarks;
+		}
+
+		bool isEnabled(const char *name) const
+		{
+			return _options.filter.empty() || strstr(name, _options.filter.c_str()) != 0;
+		}
+
+		// Runs the operation in growing batches until a batch takes long enough to be timed reliably.
+		template<class Operation> void run(const char *name, const SakuraBoard &board, double relax, Operation &operation)
+		{
+			if(!isEnabled(name))
+				return;
+
+			const int64 ticksPerSecond = Time::getHighResolutionTicksPerSecond();
+			const int64 minimalTicks = ticksPerSecond / 4;
+
+			operation();
+
+			int64 iterations = 1;
+			int64 elapsed = 0;
+			int allocations = 0;
+
+			for(;;)
+			{
+				AllocationCounter::Scope allocationScope;
+				int64 start = Time::getHighResolutionTicks();
+
+				for(int64 idx = 0; idx < iterations; idx++)
+					operation();
+
+				elapsed = Time::getHighResolutionTicks() - start;
+				allocations = allocationScope.getAllocations();
+
+				if(elapsed >= minimalTicks)
+					break;
+
+				iterations *= 2;
+			}
+
+			BenchmarkResult result;
+
+			result.name = name;
+			result.width = board.getWidth();
+			result.height = board.getHeight();
+			result.infiniteMode = board.isInfiniteMode();
+			result.relax = relax;
+			result.iterations = iterations;
+			result.nsPerOp = (double(elapsed) * 1.0e9) / (double(ticksPerSecond) * double(iterations));
+			result.cellsPerSecond = (double(board.getNumCells()) * 1.0e9) / result.nsPerOp;
+			result.allocsPerOp = double(allocations) / double(iterations);
+			result.bytesPerOp = double(operation.getBytes());
+
+			_report.add(result);
+
+			if(allocations && isSteadyState(name))
+			{
+				fprintf(stderr, "allocating: %s: %d allocations in %lld operations\n", result.getKey().c_str(), allocations, (long long)iterations);
+
+				_allocatingBenchmarks++;
+			}
+		}
+
+		void addLatencies(const std::string &name, const SakuraBoard &board, const LatencyHistogram &histogram)
+		{
+			if(!histogram.getCount() || !isEnabled(name.c_str()))
+				return;
+
+			BenchmarkResult result;
+
+			result.name = name;
+			result.width = board.getWidth();
+			result.height = board.getHeight();
+			result.infiniteMode = board.isInfiniteMode();
+			result.relax = board.getRelax();
+			result.iterations = int64(histogram.getCount());
+			result.nsPerOp = histogram.getMean();
+			result.cellsPerSecond = (result.nsPerOp > .0) ? (double(board.getNumCells()) * 1.0e9) / result.nsPerOp : .0;
+			result.p50Ns = double(histogram.getPercentile(.5));
+			result.p99Ns = double(histogram.getPercentile(.99));
+			result.maxNs = double(histogram.getMax());
+
+			_report.add(result);
+		}
+
+		// Plays the session back until enough time has been spent in it to give stable percentiles.
+		bool replay(const std::string &sessionFile)
+		{
+			const int64 minimalTicks = Time::getHighResolutionTicksPerSecond() / 4;
+
+			File file(File::getCurrentWorkingDirectory().getChildFile(sessionFile.c_str()));
+			SessionReplayer::Statistics statistics;
+			SakuraBoard board;
+			int64 start = Time::getHighResolutionTicks();
+
+			do
+			{
+				if(!SessionReplayer::replay(file, board, statistics))
+				{
+					fprintf(stderr, "can't replay the session %s\n", sessionFile.c_str());
+					return false;
+				}
+			}
+			while(Time::getHighResolutionTicks() - start < minimalTicks);
+
+			std::string name(std::string("replay/") + file.getFileNameWithoutExtension().toUTF8());
+
+			addLatencies(name + "/moves", board, statistics.moves);
+			addLatencies(name + "/generate", board, statistics.generates);
+			addLatencies(name + "/shuffle", board, statistics.shuffles);
+			addLatencies(name + "/load", board, statistics.loads);
+
+			return true;
+		}
+	};
+
+	// Keeps the results of the cheap operations alive, so the compiler can't drop the loops.
+	volatile int __sink = 0;
+
+	class DirectionsOperation
+	{
+	public:
+
+		enum Kind
+		{
+			rotate,
+			count,
+			connectionType,
+			equals
+		};
+
+	private:
+
+		std::vector<CellDirections> _directions;
+		Kind _kind;
+
+	public:
+
+		DirectionsOperation(const SakuraBoard &board, Kind kind) :
+			_directions(board.getNumCells()),
+			_kind(kind)
+		{
+			for(int y = 0; y < board.getHeight(); y++)
+				for(int x = 0; x < board.getWidth(); x++)
+					_directions[(y * board.getWidth()) + x].setMask(board.getCell(x, y).getMask(false));
+		}
+
+		void operator () ()
+		{
+			int sum = 0;
+
+			switch(_kind)
+			{
+				case rotate:
+					for(std::vector<CellDirections>::iterator it = _directions.begin(), end = _directions.end(); it != end; ++it)
+						(*it).rotate(true);
+					break;
+
+				case count:
+					for(std::vector<CellDirections>::const_iterator it = _directions.begin(), end = _directions.end(); it != end; ++it)
+						sum += (*it).count();
+					break;
+
+				case connectionType:
+					for(std::vector<CellDirections>::const_iterator it = _directions.begin(), end = _directions.end(); it != end; ++it)
+					{
+						std::pair<int, int> type = (*it).getConnectionType();
+						sum += type.first + type.second;
+					}
+					break;
+
+				case equals:
+					for(size_t idx = 1, size = _directions.size(); idx < size; idx++)
+						sum += (_directions[idx] == _directions[idx - 1]) ? 1 : 0;
+					break;
+			}
+
+			__sink = __sink + sum;
+		}
+
+		size_t getBytes() const
+		{
+			return 0;
+		}
+	};
+
+	class GenerateOperation
+	{
+	private:
+
+		SakuraBoard &_board;
+		bool _infiniteMode;
+		double _relax;
+
+	public:
+
+		GenerateOperation(SakuraBoard &board, bool infiniteMode, double relax) :
+			_board(board),
+			_infiniteMode(infiniteMode),
+			_relax(relax)
+		{
+		}
+
+		void operator () ()
+		{
+			_board.generateBranch(_infiniteMode, _relax);
+		}
+
+		size_t getBytes() const
+		{
+			return 0;
+		}
+	};
+
+	// Calls a board method that takes no arguments.
+	template<class Result> class BoardOperation
+	{
+	private:
+
+		SakuraBoard &_board;
+		Result (SakuraBoard::*_pMethod)();
+
+	public:
+
+		BoardOperation(SakuraBoard &board, Result (SakuraBoard::*pMethod)()) :
+			_board(board),
+			_pMethod(pMethod)
+		{
+		}
+
+		void operator () ()
+		{
+			(_board.*_pMethod)();
+		}
+
+		size_t getBytes() const
+		{
+			return 0;
+		}
+	};
+
+	// A player's move on every cell in turn, without the journal; four passes bring the board back.
+	class TurnCellOperation
+	{
+	private:
+
+		SakuraBoard &_board;
+		int _nextCell;
+
+	public:
+
+		TurnCellOperation(SakuraBoard &board) :
+			_board(board),
+			_nextCell(0)
+		{
+		}
+
+		void operator () ()
+		{
+			_board.turnCell(_nextCell, 1);
+			_board.clearChangedCells();
+
+			_nextCell = (_nextCell + 1) % _board.getNumCells();
+		}
+
+		size_t getBytes() const
+		{
+			return 0;
+		}
+	};
+
+	class InPlaceOperation
+	{
+	private:
+
+		const SakuraBoard &_board;
+
+	public:
+
+		InPlaceOperation(const SakuraBoard &board) : _board(board)
+		{
+		}
+
+		void operator () ()
+		{
+			__sink = __sink + (_board.isAllCellsInPlace() ? 1 : 0);
+		}
+
+		size_t getBytes() const
+		{
+			return 0;
+		}
+	};
+
+	class BitplaneOperation
+	{
+	public:
+
+		enum Kind
+		{
+			outOfPlace,
+			connectedEnds,
+			reciprocity
+		};
+
+	private:
+
+		const SakuraBoard &_board;
+		Kind _kind;
+
+	public:
+
+		BitplaneOperation(const SakuraBoard &board, Kind kind) :
+			_board(board),
+			_kind(kind)
+		{
+		}
+
+		void operator () ()
+		{
+			const BoardBitplanes &planes = _board.getBitplanes();
+
+			switch(_kind)
+			{
+				case outOfPlace:
+					__sink = __sink + planes.countOutOfPlace();
+					break;
+
+				case connectedEnds:
+					__sink = __sink + planes.countConnectedEnds(_board.isInfiniteMode());
+					break;
+
+				case reciprocity:
+					__sink = __sink + (planes.isReciprocal(false, _board.isInfiniteMode()) ? 1 : 0);
+					break;
+			}
+		}
+
+		size_t getBytes() const
+		{
+			return 0;
+		}
+	};
+
+	class EncodeOperation
+	{
+	private:
+
+		BoardState _state;
+		std::vector<uint8> _out;
+
+	public:
+
+		EncodeOperation(const SakuraBoard &board)
+		{
+			board.getState(_state);
+		}
+
+		void operator () ()
+		{
+			PuzzleCodec::encode(_state, true, _out);
+		}
+
+		size_t getBytes() const
+		{
+			return _out.size();
+		}
+	};
+
+	class DecodeOperation
+	{
+	private:
+
+		std::vector<uint8> _encoded;
+		BoardState _decoded;
+
+	public:
+
+		DecodeOperation(const SakuraBoard &board)
+		{
+			BoardState state;
+			board.getState(state);
+
+			PuzzleCodec::encode(state, true, _encoded);
+		}
+
+		void operator () ()
+		{
+			PuzzleCodec::decode(&_encoded[0], _encoded.size(), _decoded);
+		}
+
+		size_t getBytes() const
+		{
+			return _encoded.size();
+		}
+	};
+
+	// Paints into an offscreen image what the matrix window would paint, the status bar left empty.
+	class RenderOperation
+	{
+	public:
+
+		enum Kind
+		{
+			background,
+			fullFrame,
+			dirtyCell,
+			peekToggle,
+			solved
+		};
+
+		enum
+		{
+			statusBarHeight = 48
+		};
+
+	private:
+
+		const SakuraBoard &_board;
+		const BoardRenderer &_renderer;
+		Kind _kind;
+		int _width;
+		int _height;
+		Image *_pBackground;
+		Image *_pFrame;
+		int _nextCell;
+		bool _drawOriginal;
+
+		RenderOperation(const RenderOperation &);
+		RenderOperation &operator = (const RenderOperation &);
+
+	public:
+
+		RenderOperation(const SakuraBoard &board, const BoardRenderer &renderer, Kind kind) :
+			_board(board),
+			_renderer(renderer),
+			_kind(kind),
+			_width(renderer.getCellSize() * (board.getWidth() + 2)),
+			_height((renderer.getCellSize() * (board.getHeight() + 2)) + statusBarHeight),
+			_pBackground(new Image(Image::RGB, _width, _height, false)),
+			_pFrame(new Image(Image::RGB, _width, _height, false)),
+			_nextCell(0),
+			_drawOriginal(false)
+		{
+			Graphics g(*_pBackground);
+
+			_renderer.paintBackground(g, _board.getWidth(), _board.getHeight(), statusBarHeight, _width, _height);
+		}
+
+		~RenderOperation()
+		{
+			delete _pBackground;
+			delete _pFrame;
+		}
+
+		void operator () ()
+		{
+			int cellSize = _renderer.getCellSize();
+
+			switch(_kind)
+			{
+				case background:
+				{
+					Graphics g(*_pBackground);
+
+					_renderer.paintBackground(g, _board.getWidth(), _board.getHeight(), statusBarHeight, _width, _height);
+					break;
+				}
+
+				// a repainted cell gets the matrix background under it first, clipped to the cell
+				case dirtyCell:
+				{
+					int x = _nextCell % _board.getWidth();
+					int y = _nextCell / _board.getWidth();
+					int left = cellSize + (x * cellSize);
+					int top = cellSize + (y * cellSize);
+
+					_nextCell = (_nextCell + 1) % _board.getNumCells();
+
+					Graphics g(*_pFrame);
+
+					g.reduceClipRegion(left, top, cellSize, cellSize);
+					g.drawImageAt(_pBackground, 0, 0, false);
+					_renderer.paintCell(g, left, top, _board.getCell(x, y), _board.getLive(x, y), false, false);
+					break;
+				}
+
+				case peekToggle:
+					_drawOriginal = !_drawOriginal;
+
+				// the peek mode and the solved state repaint every cell, just as a full frame does
+				case fullFrame:
+				case solved:
+				{
+					Graphics g(*_pFrame);
+
+					g.drawImageAt(_pBackground, 0, 0, false);
+					_renderer.paintCells(g, cellSize, cellSize, _board, _drawOriginal);
+					break;
+				}
+			}
+		}
+
+		size_t getBytes() const
+		{
+			return 0;
+		}
+	};
+
+	// An overview of the whole board, drawn procedurally as the zoomed out matrix view draws it.
+	class LodOperation
+	{
+	private:
+
+		const SakuraBoard &_board;
+		BoardRenderer &_renderer;
+		int _cellSize;
+		Image *_pFrame;
+
+		// the view paints from a snapshot of the board, not from the board itself
+		SnapshotPublisher _snapshots;
+		const BoardSnapshot *_pSnapshot;
+
+		LodOperation(const LodOperation &);
+		LodOperation &operator = (const LodOperation &);
+
+	public:
+
+		LodOperation(const SakuraBoard &board, BoardRenderer &renderer, int cellSize) :
+			_board(board),
+			_renderer(renderer),
+			_cellSize(cellSize),
+			_pFrame(new Image(Image::RGB, board.getWidth() * cellSize, board.getHeight() * cellSize, false)),
+			_pSnapshot(_snapshots.publish(board))
+		{
+		}
+
+		~LodOperation()
+		{
+			delete _pFrame;
+		}
+
+		void operator () ()
+		{
+			Graphics g(*_pFrame);
+
+			_renderer.paintLodCells(g, *_pSnapshot, 0, 0, _board.getWidth(), _board.getHeight(), _cellSize, false);
+		}
+
+		size_t getBytes() const
+		{
+			return 0;
+		}
+	};
+
+	// Every figure of the board copied into an ARGB frame, through a JUCE Graphics or through the blit kernel.
+	class BlitOperation
+	{
+	private:
+
+		const SakuraBoard &_board;
+		const BoardRenderer &_renderer;
+		bool _kernel;
+		Image *_pFrame;
+
+		BlitOperation(const BlitOperation &);
+		BlitOperation &operator = (const BlitOperation &);
+
+	public:
+
+		BlitOperation(const SakuraBoard &board, const BoardRenderer &renderer, bool kernel) :
+			_board(board),
+			_renderer(renderer),
+			_kernel(kernel),
+			_pFrame(new Image(Image::ARGB, board.getWidth() * renderer.getCellSize(), board.getHeight() * renderer.getCellSize(), true))
+		{
+		}
+
+		~BlitOperation()
+		{
+			delete _pFrame;
+		}
+
+		void operator () ()
+		{
+			int cellSize = _renderer.getCellSize();
+
+			if(_kernel)
+			{
+				for(int y = 0; y < _board.getHeight(); y++)
+					for(int x = 0; x < _board.getWidth(); x++)
+						_renderer.blitCell(*_pFrame, x * cellSize, y * cellSize, _board.getCell(x, y), _board.getLive(x, y), false);
+
+				return;
+			}
+
+			Graphics g(*_pFrame);
+
+			for(int y = 0; y < _board.getHeight(); y++)
+				for(int x = 0; x < _board.getWidth(); x++)
+					_renderer.paintCell(g, x * cellSize, y * cellSize, _board.getCell(x, y), _board.getLive(x, y), false, false);
+		}
+
+		// the figure pixels blended per run, so the time per pixel follows from the bytes per op
+		size_t getBytes() const
+		{
+			return size_t(_board.getNumCells()) * _renderer.getCellSize() * _renderer.getCellSize() * sizeof(uint32);
+		}
+	};
+
+	// Returns false if the kernel's blend differs from the scalar one anywhere: opaque, clear and translucent pixels,
+	// rows of every length up to a few vectors, starting off the vector alignment.
+	bool checkBlitKernel(BenchmarkRunner &runner)
+	{
+		enum
+		{
+			maxCount = 67,
+			maxOffset = 4
+		};
+
+		if(!runner.isEnabled("check/blit"))
+			return true;
+
+		uint32 source[maxCount + maxOffset];
+		uint32 dest[maxCount + maxOffset];
+		uint32 expected[maxCount + maxOffset];
+		uint32 random = 1;
+
+		for(int round = 0; round < 64; round++)
+			for(int offset = 0; offset < maxOffset; offset++)
+				for(int count = 0; count <= maxCount; count++)
+				{
+					for(int idx = 0; idx < maxCount + maxOffset; idx++)
+					{
+						random = (random * 1664525) + 1013904223;
+
+						// premultiplied, so no colour byte is above the alpha
+						uint32 alpha = (random >> 30) == 0 ? 0 : ((random >> 30) == 1 ? 0xff : (random >> 8) & 0xff);
+						uint32 pixel = alpha << 24;
+
+						for(int shift = 0; shift < 24; shift += 8)
+						{
+							random = (random * 1664525) + 1013904223;
+							pixel |= (((random >> 16) & 0xffff) * (alpha + 1) >> 16) << shift;
+						}
+
+						source[idx] = pixel;
+
+						random = (random * 1664525) + 1013904223;
+						dest[idx] = expected[idx] = 0xff000000 | (random >> 8);
+					}
+
+					PixelBlitter::blendRow(dest + offset, source + offset, count);
+					PixelBlitter::blendRowScalar(expected + offset, source + offset, count);
+
+					if(memcmp(dest, expected, sizeof(dest)) != 0)
+					{
+						fprintf(stderr, "blit mismatch: the %s kernel against the scalar one, %d pixels from %d\n",
+							PixelBlitter::getKernelName(), count, offset);
+
+						return false;
+					}
+				}
+
+		return true;
+	}
+
+	void runLodBenchmarks(BenchmarkRunner &runner, SakuraBoard &board, BoardRenderer &renderer)
+	{
+		static const int __lodCellSizes[] = { 1, 4, 8 };
+
+		board.generateBranch(false, .1);
+		board.shuffle();
+
+		for(size_t idx = 0; idx < sizeof(__lodCellSizes) / sizeof(__lodCellSizes[0]); idx++)
+		{
+			char name[64];
+			sprintf(name, "render/lod_overview/%dpx", __lodCellSizes[idx]);
+
+			if(!runner.isEnabled(name))
+				continue;
+
+			LodOperation render(board, renderer, __lodCellSizes[idx]);
+			runner.run(name, board, board.getRelax(), render);
+		}
+	}
+
+	void runRenderBenchmarks(BenchmarkRunner &runner, SakuraBoard &board, BoardRenderer &renderer, int cellSize)
+	{
+		static const struct
+		{
+			const char *pName;
+			RenderOperation::Kind kind;
+		}
+		__operations[] =
+		{
+			{ "render/background", RenderOperation::background },
+			{ "render/full_frame", RenderOperation::fullFrame },
+			{ "render/dirty_cell", RenderOperation::dirtyCell },
+			{ "render/peek_toggle", RenderOperation::peekToggle },
+			{ "render/solved", RenderOperation::solved }
+		};
+
+		renderer.setCellSize(cellSize);
+
+		// a shuffled branch, so the dead and the live figures both get drawn
+		board.generateBranch(false, .1);
+		board.shuffle();
+
+		for(size_t idx = 0; idx < sizeof(__operations) / sizeof(__operations[0]); idx++)
+		{
+			char name[64];
+			sprintf(name, "%s/%dpx", __operations[idx].pName, cellSize);
+
+			if(!runner.isEnabled(name))
+				continue;
+
+			if(__operations[idx].kind == RenderOperation::solved)
+				board.setAllCellsLive(SakuraBoard::Solved);
+
+			RenderOperation render(board, renderer, __operations[idx].kind);
+			runner.run(name, board, board.getRelax(), render);
+		}
+
+		for(int kernel = 0; kernel < 2; kernel++)
+		{
+			char name[64];
+			sprintf(name, "%s/%dpx", kernel ? "blit/kernel" : "blit/juce_draw_image", cellSize);
+
+			if(!runner.isEnabled(name))
+				continue;
+
+			BlitOperation blit(board, renderer, kernel != 0);
+			runner.run(name, board, board.getRelax(), blit);
+		}
+	}
+
+	// Puts the puzzles of a mapped pack on the board one after another, as the pack mode does.
+	class PackLoadOperation
+	{
+	private:
+
+		const PuzzlePack &_pack;
+		SakuraBoard &_board;
+		int _nextPuzzle;
+
+	public:
+
+		PackLoadOperation(const PuzzlePack &pack, SakuraBoard &board) :
+			_pack(pack),
+			_board(board),
+			_nextPuzzle(0)
+		{
+		}
+
+		void operator () ()
+		{
+			PuzzleRecord record;
+
+			if(_pack.getPuzzle(_nextPuzzle, record))
+				_board.setPuzzle(record);
+
+			_nextPuzzle = (_nextPuzzle + 1) % _pack.getNumPuzzles();
+		}
+
+		size_t getBytes() const
+		{
+			return size_t(PuzzlePack::recordHeaderSize) + ((size_t(_board.getNumCells()) + 1) / 2);
+		}
+	};
+
+	bool isSamePuzzle(const BoardState &source, const BoardState &loaded)
+	{
+		if(loaded.width != source.width || loaded.height != source.height ||
+			loaded.rootX != source.rootX || loaded.rootY != source.rootY ||
+			loaded.infiniteMode != source.infiniteMode || loaded.seed != source.seed ||
+			int(loaded.relax * 1000. + .5) != int(source.relax * 1000. + .5) || loaded.cells.size() != source.cells.size())
+			return false;
+
+		// a pack keeps the solved directions only, and a loaded puzzle starts solved
+		for(size_t idx = 0, size = source.cells.size(); idx < size; idx++)
+			if((loaded.cells[idx] & 0x0f) != (source.cells[idx] & 0x0f) || (loaded.cells[idx] >> 4) != (source.cells[idx] & 0x0f))
+				return false;
+
+		return true;
+	}
+
+	// Returns false if a puzzle read back from the mapped pack differs from the one written.
+	bool runPackBenchmarks(BenchmarkRunner &runner, SakuraBoard &board)
+	{
+		static const int __packSize = 8;
+
+		const char *name = "pack/load_puzzle";
+
+		if(!runner.isEnabled(name))
+			return true;
+
+		File file(File::createTempFile(T(".pack")));
+		std::vector<BoardState> sources(__packSize);
+
+		{
+			PuzzlePackWriter writer;
+
+			if(!writer.open(file))
+			{
+				fprintf(stderr, "can't write the pack %s\n", file.getFullPathName().toUTF8());
+				return false;
+			}
+
+			for(int idx = 0; idx < __packSize; idx++)
+			{
+				board.generateBranch((idx & 1) != 0, idx * .05, uint32(idx + 1));
+				board.getState(sources[idx]);
+
+				writer.addPuzzle(sources[idx]);
+			}
+
+			if(!writer.close())
+			{
+				fprintf(stderr, "can't write the pack %s\n", file.getFullPathName().toUTF8());
+				return false;
+			}
+		}
+
+		PuzzlePack pack;
+		bool same = pack.open(file) && pack.getNumPuzzles() == __packSize;
+		BoardState loaded;
+
+		for(int idx = 0; same && idx < __packSize; idx++)
+		{
+			PuzzleRecord record;
+
+			same = pack.getPuzzle(idx, record);
+
+			if(same)
+			{
+				board.setPuzzle(record);
+				board.getState(loaded);
+
+				same = isSamePuzzle(sources[idx], loaded);
+			}
+
+			if(!same)
+				fprintf(stderr, "pack mismatch: puzzle %d of %dx%d\n", idx, board.getWidth(), board.getHeight());
+		}
+
+		if(same)
+		{
+			PackLoadOperation load(pack, board);
+			runner.run(name, board, board.getRelax(), load);
+		}
+
+		pack.close();
+		file.deleteFile();
+
+		return same;
+	}
+
+	// Returns false if a liveness mode marks other cells live than the flood fill does on the board as it is.
+	bool isSameLiveness(SakuraBoard &board, const char *pBoardState)
+	{
+		static const struct
+		{
+			const char *pName;
+			SakuraBoard::LivenessMode mode;
+		}
+		__modes[] =
+		{
+			{ "bit-parallel", SakuraBoard::bitParallelLiveness },
+			{ "tiled", SakuraBoard::tiledLiveness }
+		};
+
+		board.setLivenessMode(SakuraBoard::floodLiveness);
+		board.drawAlivePath();
+
+		std::vector<uint8> flood(board.getLiveStates());
+		bool same = true;
+
+		for(size_t idx = 0; idx < sizeof(__modes) / sizeof(__modes[0]); idx++)
+		{
+			board.setLivenessMode(__modes[idx].mode);
+			board.drawAlivePath();
+
+			if(board.getLiveStates() != flood)
+			{
+				fprintf(stderr, "liveness mismatch: %s against the flood fill on the %s %dx%d %s board, relax %.2f\n", __modes[idx].pName,
+					pBoardState, board.getWidth(), board.getHeight(), board.isInfiniteMode() ? "torus" : "regular", board.getRelax());
+
+				same = false;
+			}
+		}
+
+		board.setLivenessMode(SakuraBoard::bitParallelLiveness);
+		board.drawAlivePath();
+
+		return same;
+	}
+
+	// The solved branch, the branch with some of its cells turned away and the shuffled board.
+	bool checkLiveness(BenchmarkRunner &runner, SakuraBoard &board, bool infiniteMode, double relax)
+	{
+		if(!runner.isEnabled("check/liveness"))
+			return true;
+
+		board.generateBranch(infiniteMode, relax, 1);
+
+		bool same = isSameLiveness(board, "solved");
+
+		// the same cells on every run, whatever the benchmarks drew from rand()
+		uint32 random = 1;
+
+		for(int turns = board.getNumCells() / 2048; turns >= 0; turns--)
+		{
+			random = (random * 1664525) + 1013904223;
+
+			board.turnCell(int((random >> 8) % uint32(board.getNumCells())), 1 + int(random & 1));
+		}
+
+		board.clearChangedCells();
+
+		// the moves keep the live cells up to date on their own, as they do in play
+		std::vector<uint8> moved(board.getLiveStates());
+
+		same = isSameLiveness(board, "turned") && same;
+
+		if(board.getLiveStates() != moved)
+		{
+			fprintf(stderr, "liveness mismatch: the moves against the flood fill on the turned %dx%d %s board, relax %.2f\n",
+				board.getWidth(), board.getHeight(), infiniteMode ? "torus" : "regular", relax);
+
+			same = false;
+		}
+
+		board.shuffle(1);
+
+		return isSameLiveness(board, "shuffled") && same;
+	}
+
+	void runBoardBenchmarks(BenchmarkRunner &runner, SakuraBoard &board, bool infiniteMode, double relax)
+	{
+		board.generateBranch(infiniteMode, relax);
+
+		// a freshly generated branch is solved, so these have to look at every cell
+		DirectionsOperation rotate(board, DirectionsOperation::rotate);
+		runner.run("directions/rotate", board, relax, rotate);
+
+		DirectionsOperation count(board, DirectionsOperation::count);
+		runner.run("directions/count", board, relax, count);
+
+		DirectionsOperation connectionType(board, DirectionsOperation::connectionType);
+		runner.run("directions/connection_type", board, relax, connectionType);
+
+		DirectionsOperation equals(board, DirectionsOperation::equals);
+		runner.run("directions/equals", board, relax, equals);
+
+		InPlaceOperation inPlace(board);
+		runner.run("board/is_all_cells_in_place", board, relax, inPlace);
+
+		BitplaneOperation outOfPlace(board, BitplaneOperation::outOfPlace);
+		runner.run("bitplanes/count_out_of_place", board, relax, outOfPlace);
+
+		BitplaneOperation connectedEnds(board, BitplaneOperation::connectedEnds);
+		runner.run("bitplanes/count_connected_ends", board, relax, connectedEnds);
+
+		BitplaneOperation reciprocity(board, BitplaneOperation::reciprocity);
+		runner.run("bitplanes/is_reciprocal", board, relax, reciprocity);
+
+		BoardOperation<bool> positionRoot(board, &SakuraBoard::positionRoot);
+		runner.run("board/position_root", board, relax, positionRoot);
+
+		GenerateOperation generate(board, infiniteMode, relax);
+		runner.run("board/generate_branch", board, relax, generate);
+
+		BoardOperation<void> shuffle(board, &SakuraBoard::shuffle);
+		runner.run("board/shuffle", board, relax, shuffle);
+
+		BoardOperation<void> drawAlivePath(board, &SakuraBoard::drawAlivePath);
+		runner.run("board/draw_alive_path", board, relax, drawAlivePath);
+
+		TurnCellOperation turnCell(board);
+		runner.run("board/turn_cell", board, relax, turnCell);
+
+		board.setLivenessMode(SakuraBoard::floodLiveness);
+		runner.run("board/draw_alive_path_flood", board, relax, drawAlivePath);
+
+		board.setLivenessMode(SakuraBoard::tiledLiveness);
+		runner.run("board/draw_alive_path_tiled", board, relax, drawAlivePath);
+		board.setLivenessMode(SakuraBoard::bitParallelLiveness);
+
+		if(runner.isEnabled("codec/encode"))
+		{
+			EncodeOperation encode(board);
+			runner.run("codec/encode", board, relax, encode);
+		}
+
+		if(runner.isEnabled("codec/decode"))
+		{
+			DecodeOperation decode(board);
+			runner.run("codec/decode", board, relax, decode);
+		}
+	}
+
+	void parseOptions(int argc, char **argv, BenchmarkOptions &options)
+	{
+		for(int idx = 1; idx < argc; idx++)
+		{
+			const char *pArgument = argv[idx];
+
+			if(!strncmp(pArgument, "--filter=", 9))
+				options.filter = pArgument + 9;
+			else if(!strncmp(pArgument, "--out=", 6))
+				options.outputFile = pArgument + 6;
+			else if(!strncmp(pArgument, "--baseline=", 11))
+				options.baselineFile = pArgument + 11;
+			else if(!strncmp(pArgument, "--tolerance=", 12))
+				options.tolerance = atof(pArgument + 12);
+			else if(!strncmp(pArgument, "--max-cells=", 12))
+				options.maxCells = atoi(pArgument + 12);
+			else if(!strncmp(pArgument, "--replay=", 9))
+				options.sessionFiles.push_back(pArgument + 9);
+			else
+				fprintf(stderr, "unknown option: %s\n", pArgument);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const int __sizes[][2] = { { 7, 6 }, { 32, 32 }, { 128, 128 }, { 512, 512 }, { 2000, 2000 } };
+	static const double __relaxValues[] = { .0, .1, .3 };
+	static const int __renderSizes[][2] = { { 7, 6 }, { 32, 32 }, { 128, 128 } };
+	static const int __cellSizes[] = { 16, 32, 48 };
+	static const int __maxPixels = 4200 * 4200;
+
+	initialiseJuce_NonGUI();
+
+	BenchmarkOptions options;
+	parseOptions(argc, argv, options);
+
+	std::srand(1);
+
+	BenchmarkReport report;
+	BenchmarkRunner runner(options, report);
+	int failedPacks = 0;
+	int failedChecks = 0;
+
+	for(size_t sizeIndex = 0; sizeIndex < sizeof(__sizes) / sizeof(__sizes[0]); sizeIndex++)
+	{
+		if(__sizes[sizeIndex][0] * __sizes[sizeIndex][1] > options.maxCells)
+			continue;
+
+		SakuraBoard board;
+		board.resize(__sizes[sizeIndex][0], __sizes[sizeIndex][1]);
+
+		for(int infiniteMode = 0; infiniteMode < 2; infiniteMode++)
+			for(size_t relaxIndex = 0; relaxIndex < sizeof(__relaxValues) / sizeof(__relaxValues[0]); relaxIndex++)
+			{
+				runBoardBenchmarks(runner, board, infiniteMode != 0, __relaxValues[relaxIndex]);
+
+				if(!checkLiveness(runner, board, infiniteMode != 0, __relaxValues[relaxIndex]))
+					failedChecks++;
+			}
+
+		if(!runPackBenchmarks(runner, board))
+			failedPacks++;
+	}
+
+	BoardRenderer renderer;
+	renderer.loadFigures();
+	renderer.loadDecor();
+	renderer.loadOrnaments();
+
+	fprintf(stderr, "blit kernel: %s\n", PixelBlitter::getKernelName());
+
+	if(!checkBlitKernel(runner))
+		failedChecks++;
+
+	for(size_t sizeIndex = 0; sizeIndex < sizeof(__renderSizes) / sizeof(__renderSizes[0]); sizeIndex++)
+	{
+		if(__renderSizes[sizeIndex][0] * __renderSizes[sizeIndex][1] > options.maxCells)
+			continue;
+
+		SakuraBoard board;
+		board.resize(__renderSizes[sizeIndex][0], __renderSizes[sizeIndex][1]);
+
+		for(size_t cellSizeIndex = 0; cellSizeIndex < sizeof(__cellSizes) / sizeof(__cellSizes[0]); cellSizeIndex++)
+		{
+			int cellSize = __cellSizes[cellSizeIndex];
+
+			if((cellSize * (board.getWidth() + 2)) * (cellSize * (board.getHeight() + 2)) <= __maxPixels)
+				runRenderBenchmarks(runner, board, renderer, cellSize);
+		}
+	}
+
+	// a million cells, zoomed out
+	if(1024 * 1024 <= options.maxCells)
+	{
+		SakuraBoard board;
+		board.resize(1024, 1024);
+
+		runLodBenchmarks(runner, board, renderer);
+	}
+
+	int failedReplays = 0;
+
+	for(std::vector<std::string>::const_iterator it = options.sessionFiles.begin(), end = options.sessionFiles.end(); it != end; ++it)
+		if(!runner.replay(*it))
+			failedReplays++;
+
+	FILE *pOut = options.outputFile.empty() ? stdout : fopen(options.outputFile.c_str(), "w");
+
+	if(pOut)
+	{
+		report.write(pOut);
+
+		if(pOut != stdout)
+			fclose(pOut);
+	}
+
+	int regressions = 0;
+
+	if(!options.baselineFile.empty())
+	{
+		FILE *pBaseline = fopen(options.baselineFile.c_str(), "r");
+
+		if(pBaseline)
+		{
+			regressions = report.compare(pBaseline, options.tolerance);
+			fclose(pBaseline);
+		}
+		else
+			fprintf(stderr, "can't open the baseline %s\n", options.baselineFile.c_str());
+	}
+
+	shutdownJuce_NonGUI();
+
+	return (regressions || failedReplays || failedPacks || failedChecks || runner.getAllocatingBenchmarks()) ? 1 : 0;
+}
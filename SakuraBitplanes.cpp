@@ -0,0 +1,271 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraBitplanes.h"
+
+void BoardBitplanes::resize(int width, int height)
+{
+	_width = width;
+	_height = height;
+	_wordsPerRow = (width + 63) / 64;
+	_planeWords = _wordsPerRow * height;
+
+	_words.assign(size_t(_planeWords) * 8, uint64(0));
+	_east.assign(_planeWords, uint64(0));
+	_south.assign(_planeWords, uint64(0));
+	_spread.assign(_planeWords, uint64(0));
+	_queued.assign(_planeWords, uint8(0));
+	_queue.reserve(_planeWords);
+}
+
+bool BoardBitplanes::isAllInPlace() const
+{
+	const uint64 *pCurrent = &_words[current * _planeWords];
+	const uint64 *pOriginal = &_words[original * _planeWords];
+
+	for(int direction = 0; direction < 4; direction++, pCurrent += _planeWords, pOriginal += _planeWords)
+	{
+		uint64 difference = 0;
+
+		for(int word = 0; word < _planeWords; word++)
+			difference |= pCurrent[word] ^ pOriginal[word];
+
+		if(difference)
+			return false;
+	}
+
+	return true;
+}
+
+int BoardBitplanes::countOutOfPlace() const
+{
+	const uint64 *pCurrent = &_words[current * _planeWords];
+	const uint64 *pOriginal = &_words[original * _planeWords];
+	int count = 0;
+
+	for(int word = 0; word < _planeWords; word++)
+	{
+		uint64 difference = 0;
+
+		for(int direction = 0; direction < 4; direction++)
+			difference |= pCurrent[(direction * _planeWords) + word] ^ pOriginal[(direction * _planeWords) + word];
+
+		count += countBits(difference);
+	}
+
+	return count;
+}
+
+int BoardBitplanes::countConnectedEnds(bool infiniteMode) const
+{
+	int count = 0;
+
+	for(int y = 0; y < _height; y++)
+	{
+		const uint64 *pLeft = getRow(current + 0, y);
+		const uint64 *pRight = getRow(current + 2, y);
+		const uint64 *pBottom = getRow(current + 3, y);
+		const uint64 *pTopBelow = (y + 1 < _height) ? getRow(current + 1, y + 1) : (infiniteMode ? getRow(current + 1, 0) : 0);
+
+		for(int word = 0; word < _wordsPerRow; word++)
+		{
+			count += countBits(pRight[word] & getRightNeighbours(pLeft, word, infiniteMode));
+
+			if(pTopBelow)
+				count += countBits(pBottom[word] & pTopBelow[word]);
+		}
+	}
+
+	return count * 2;
+}
+
+bool BoardBitplanes::isReciprocal(bool originalState, bool infiniteMode) const
+{
+	int base = originalState ? original : current;
+
+	for(int y = 0; y < _height; y++)
+	{
+		const uint64 *pLeft = getRow(base + 0, y);
+		const uint64 *pRight = getRow(base + 2, y);
+		const uint64 *pBottom = getRow(base + 3, y);
+		const uint64 *pTopBelow = (y + 1 < _height) ? getRow(base + 1, y + 1) : (infiniteMode ? getRow(base + 1, 0) : 0);
+
+		uint64 mismatch = 0;
+
+		for(int word = 0; word < _wordsPerRow; word++)
+		{
+			mismatch |= pRight[word] ^ getRightNeighbours(pLeft, word, infiniteMode);
+			mismatch |= pBottom[word] ^ (pTopBelow ? pTopBelow[word] : 0);
+		}
+
+		// without the wrap the first column and the first row can't lead out either
+		if(!infiniteMode)
+		{
+			mismatch |= pLeft[0] & 1;
+
+			if(!y)
+				for(int word = 0; word < _wordsPerRow; word++)
+					mismatch |= getRow(base + 1, 0)[word];
+		}
+
+		if(mismatch)
+			return false;
+	}
+
+	return true;
+}
+
+// A left quarter-turn moves every direction one step down: left takes top, top takes right and so on.
+void BoardBitplanes::rotateLeft(const std::vector<uint64> &oneTurn, const std::vector<uint64> &twoTurns)
+{
+	uint64 *pLeft = &_words[(current + 0) * _planeWords];
+	uint64 *pTop = &_words[(current + 1) * _planeWords];
+	uint64 *pRight = &_words[(current + 2) * _planeWords];
+	uint64 *pBottom = &_words[(current + 3) * _planeWords];
+
+	for(int word = 0; word < _planeWords; word++)
+	{
+		uint64 one = oneTurn[word];
+		uint64 two = twoTurns[word];
+
+		uint64 left = (pLeft[word] & ~two) | (pRight[word] & two);
+		uint64 top = (pTop[word] & ~two) | (pBottom[word] & two);
+		uint64 right = (pRight[word] & ~two) | (pLeft[word] & two);
+		uint64 bottom = (pBottom[word] & ~two) | (pTop[word] & two);
+
+		pLeft[word] = (left & ~one) | (top & one);
+		pTop[word] = (top & ~one) | (right & one);
+		pRight[word] = (right & ~one) | (bottom & one);
+		pBottom[word] = (bottom & ~one) | (left & one);
+	}
+}
+
+void BoardBitplanes::computeConnections(bool infiniteMode, int firstRow, int endRow)
+{
+	for(int y = firstRow; y < endRow; y++)
+	{
+		const uint64 *pLeft = getRow(current + 0, y);
+		const uint64 *pRight = getRow(current + 2, y);
+		const uint64 *pBottom = getRow(current + 3, y);
+		const uint64 *pTopBelow = (y + 1 < _height) ? getRow(current + 1, y + 1) : (infiniteMode ? getRow(current + 1, 0) : 0);
+
+		for(int word = 0; word < _wordsPerRow; word++)
+		{
+			_east[(y * _wordsPerRow) + word] = pRight[word] & getRightNeighbours(pLeft, word, infiniteMode);
+			_south[(y * _wordsPerRow) + word] = pTopBelow ? (pBottom[word] & pTopBelow[word]) : 0;
+		}
+	}
+}
+
+// A worklist of words rather than of cells: a word is filled along its row in one go,
+// and only the cells that came alive since its last visit are handed on to the neighbouring words.
+int BoardBitplanes::propagateLive(int rootX, int rootY, bool infiniteMode, std::vector<uint64> &live)
+{
+	live.assign(_planeWords, uint64(0));
+	std::fill(_spread.begin(), _spread.end(), uint64(0));
+	std::fill(_queued.begin(), _queued.end(), uint8(0));
+	_queue.clear();
+
+	computeConnections(infiniteMode, 0, _height);
+
+	int lastWord = _wordsPerRow - 1;
+	int lastBit = (_width - 1) & 63;
+	uint64 lastWordMask = (lastBit == 63) ? ~uint64(0) : ((uint64(1) << (lastBit + 1)) - 1);
+	uint64 rootBit = uint64(1) << (rootX & 63);
+	int rootIndex = (rootY * _wordsPerRow) + (rootX >> 6);
+	int visits = 0;
+
+	live[rootIndex] = rootBit;
+	enqueueWord(rootIndex);
+
+	while(!_queue.empty())
+	{
+		int index = _queue.back();
+		_queue.pop_back();
+		_queued[index] = 0;
+
+		int y = index / _wordsPerRow;
+		int word = index % _wordsPerRow;
+		uint64 east = _east[index];
+
+		// a cell can be entered from the left if the cell on its left connects to it
+		uint64 enter = east << 1;
+
+		if(word == lastWord)
+			enter &= lastWordMask;
+
+		uint64 bits = fillDown(fillUp(live[index], enter), east);
+		uint64 fresh = bits & ~_spread[index];
+
+		live[index] = bits;
+		_spread[index] = bits;
+		visits++;
+
+		if(!fresh)
+			continue;
+
+		int topBit = (word == lastWord) ? lastBit : 63;
+
+		// along the row, across the word boundaries and around the torus
+		if(((fresh & east) >> topBit) & 1)
+		{
+			if(word < lastWord)
+				markCells(live, index + 1, 1);
+			else if(infiniteMode)
+				markCells(live, y * _wordsPerRow, 1);
+		}
+
+		if(fresh & 1)
+		{
+			if(word)
+			{
+				if((_east[index - 1] >> 63) & 1)
+					markCells(live, index - 1, uint64(1) << 63);
+			}
+			else if(infiniteMode && ((_east[(y * _wordsPerRow) + lastWord] >> lastBit) & 1))
+				markCells(live, (y * _wordsPerRow) + lastWord, uint64(1) << lastBit);
+		}
+
+		// and to the rows above and below
+		if(y + 1 < _height || infiniteMode)
+			markCells(live, (((y + 1) % _height) * _wordsPerRow) + word, fresh & _south[index]);
+
+		if(y || infiniteMode)
+		{
+			int above = (((y ? y : _height) - 1) * _wordsPerRow) + word;
+
+			markCells(live, above, fresh & _south[above]);
+		}
+	}
+
+	// the root alone isn't a branch
+	if(live[rootIndex] == rootBit)
+	{
+		bool connected = false;
+
+		for(int index = 0; index < _planeWords && !connected; index++)
+			connected = (index != rootIndex) && live[index];
+
+		if(!connected)
+			live[rootIndex] = 0;
+	}
+
+	return visits;
+}
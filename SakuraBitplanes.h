@@ -0,0 +1,277 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+
+#include <vector>
+#include <algorithm>
+
+// The directions of a whole board as bitplanes: one bit per cell for each of the four directions
+// of the original and of the current state. Every row starts on a fresh 64-bit word, so the neighbour
+// below is the same word of the next row and the neighbour to the right is a one-bit shift.
+// The whole-board checks then run a word at a time instead of a cell at a time.
+class BoardBitplanes
+{
+public:
+
+	enum
+	{
+		current = 0,
+		original = 4
+	};
+
+private:
+
+	std::vector<uint64> _words;
+
+	// scratch for the liveness propagation: the connections to the right and below that both cells agree on,
+	// the live cells already handed on to the neighbouring words and the words waiting for a visit
+	std::vector<uint64> _east;
+	std::vector<uint64> _south;
+	std::vector<uint64> _spread;
+	std::vector<int> _queue;
+	std::vector<uint8> _queued;
+	int _width;
+	int _height;
+	int _wordsPerRow;
+	int _planeWords;
+
+	uint64 *getRow(int plane, int y)
+	{
+		return &_words[(plane * _planeWords) + (y * _wordsPerRow)];
+	}
+
+	const uint64 *getRow(int plane, int y) const
+	{
+		return &_words[(plane * _planeWords) + (y * _wordsPerRow)];
+	}
+
+	// The bits of the cells to the right of the ones in the given word, wrapping around the row if asked.
+	uint64 getRightNeighbours(const uint64 *pRow, int word, bool wrap) const
+	{
+		uint64 bits = pRow[word] >> 1;
+
+		if(word + 1 < _wordsPerRow)
+			bits |= pRow[word + 1] << 63;
+		else if(wrap)
+			bits |= (pRow[0] & 1) << ((_width - 1) & 63);
+
+		return bits;
+	}
+
+	// Occluded fills: spread the bits of gen through the runs of pro towards the higher or the lower bits,
+	// where a bit of pro says the cell can be entered from the neighbour the fill comes from.
+	static uint64 fillUp(uint64 gen, uint64 pro)
+	{
+		gen |= pro & (gen << 1);
+		pro &= pro << 1;
+		gen |= pro & (gen << 2);
+		pro &= pro << 2;
+		gen |= pro & (gen << 4);
+		pro &= pro << 4;
+		gen |= pro & (gen << 8);
+		pro &= pro << 8;
+		gen |= pro & (gen << 16);
+		pro &= pro << 16;
+
+		return gen | (pro & (gen << 32));
+	}
+
+	static uint64 fillDown(uint64 gen, uint64 pro)
+	{
+		gen |= pro & (gen >> 1);
+		pro &= pro >> 1;
+		gen |= pro & (gen >> 2);
+		pro &= pro >> 2;
+		gen |= pro & (gen >> 4);
+		pro &= pro >> 4;
+		gen |= pro & (gen >> 8);
+		pro &= pro >> 8;
+		gen |= pro & (gen >> 16);
+		pro &= pro >> 16;
+
+		return gen | (pro & (gen >> 32));
+	}
+
+	void enqueueWord(int index)
+	{
+		if(!_queued[index])
+		{
+			_queued[index] = 1;
+			_queue.push_back(index);
+		}
+	}
+
+	void markCells(std::vector<uint64> &live, int index, uint64 bits)
+	{
+		if(bits & ~live[index])
+		{
+			live[index] |= bits;
+			enqueueWord(index);
+		}
+	}
+
+	static int countBits(uint64 bits)
+	{
+		bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+		bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+		bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+
+		return int((bits * 0x0101010101010101ULL) >> 56);
+	}
+
+public:
+
+	BoardBitplanes() :
+		_width(0),
+		_height(0),
+		_wordsPerRow(0),
+		_planeWords(0)
+	{
+	}
+
+	void resize(int width, int height);
+
+	void clear()
+	{
+		std::fill(_words.begin(), _words.end(), uint64(0));
+	}
+
+	int getWidth() const
+	{
+		return _width;
+	}
+
+	int getHeight() const
+	{
+		return _height;
+	}
+
+	int getWordsPerRow() const
+	{
+		return _wordsPerRow;
+	}
+
+	static int getLowestBit(uint64 bits)
+	{
+		int bit = 0;
+
+		if(!(bits & 0xffffffffULL))
+		{
+			bits >>= 32;
+			bit += 32;
+		}
+
+		if(!(bits & 0xffff))
+		{
+			bits >>= 16;
+			bit += 16;
+		}
+
+		if(!(bits & 0xff))
+		{
+			bits >>= 8;
+			bit += 8;
+		}
+
+		if(!(bits & 0x0f))
+		{
+			bits >>= 4;
+			bit += 4;
+		}
+
+		if(!(bits & 0x03))
+		{
+			bits >>= 2;
+			bit += 2;
+		}
+
+		return bit + int(!(bits & 1));
+	}
+
+	void setMasks(int x, int y, int originalMask, int currentMask)
+	{
+		uint64 bit = uint64(1) << (x & 63);
+		int offset = (y * _wordsPerRow) + (x >> 6);
+
+		for(int direction = 0; direction < 4; direction++)
+		{
+			uint64 &originalWord = _words[((original + direction) * _planeWords) + offset];
+			uint64 &currentWord = _words[((current + direction) * _planeWords) + offset];
+
+			originalWord = (originalMask & (1 << direction)) ? (originalWord | bit) : (originalWord & ~bit);
+			currentWord = (currentMask & (1 << direction)) ? (currentWord | bit) : (currentWord & ~bit);
+		}
+	}
+
+	int getMask(int x, int y, bool originalState = false) const
+	{
+		int offset = (y * _wordsPerRow) + (x >> 6);
+		int base = originalState ? original : current;
+		int mask = 0;
+
+		for(int direction = 0; direction < 4; direction++)
+			mask |= int((_words[((base + direction) * _planeWords) + offset] >> (x & 63)) & 1) << direction;
+
+		return mask;
+	}
+
+	bool isAllInPlace() const;
+	int countOutOfPlace() const;
+
+	// Both ends of every connection in the current state, i.e. twice the number of connections.
+	int countConnectedEnds(bool infiniteMode) const;
+
+	// Whether every connection of the given state has its counterpart in the neighbouring cell,
+	// and, unless the board wraps around, none leads out of the board.
+	bool isReciprocal(bool originalState, bool infiniteMode) const;
+
+	// Works out the connections to the right and below that both cells agree on in the current state,
+	// for the rows from firstRow up to endRow; distinct rows can be done on distinct threads.
+	void computeConnections(bool infiniteMode, int firstRow, int endRow);
+
+	const uint64 *getEastRow(int y) const
+	{
+		return &_east[y * _wordsPerRow];
+	}
+
+	const uint64 *getSouthRow(int y) const
+	{
+		return &_south[y * _wordsPerRow];
+	}
+
+	// Marks the cells connected to the root in the current state, with the layout of a plane.
+	// The live cells spread through a word, i.e. along 64 cells of a row, in a handful of shifts,
+	// then on to the neighbouring words. Like the flood fill, an isolated root stays dead.
+	// Returns the number of word visits.
+	int propagateLive(int rootX, int rootY, bool infiniteMode, std::vector<uint64> &live);
+
+	// Turns the current state of every cell left by (bit of oneTurn) + 2 * (bit of twoTurns) quarter-turns;
+	// the masks are laid out like a plane.
+	void rotateLeft(const std::vector<uint64> &oneTurn, const std::vector<uint64> &twoTurns);
+
+	size_t getMemoryUsage() const
+	{
+		return ((_words.capacity() + _east.capacity() + _south.capacity() + _spread.capacity()) * sizeof(uint64)) +
+			(_queue.capacity() * sizeof(int)) + _queued.capacity();
+	}
+};
@@ -0,0 +1,202 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraBlit.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// x * y / 255 for bytes spread over 16-bit lanes, rounded
+	inline uint32 scalePairs(uint32 pairs, uint32 scale)
+	{
+		uint32 product = (pairs * scale) + 0x00800080;
+
+		return ((product + ((product >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+	}
+
+	inline uint32 blendPixel(uint32 dest, uint32 source)
+	{
+		uint32 alpha = source >> 24;
+
+		if(alpha == 0xff)
+			return source;
+
+		if(!alpha)
+			return dest;
+
+		uint32 inverse = 0xff - alpha;
+
+		return source + scalePairs(dest & 0x00ff00ff, inverse) + (scalePairs((dest >> 8) & 0x00ff00ff, inverse) << 8);
+	}
+
+#if defined(__SSE2__)
+	// two pixels spread over eight 16-bit lanes
+	inline __m128i blendPairs(__m128i dest, __m128i source)
+	{
+		const __m128i mask = _mm_set1_epi16(0xff);
+		const __m128i half = _mm_set1_epi16(0x80);
+
+		__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		__m128i product = _mm_add_epi16(_mm_mullo_epi16(dest, _mm_xor_si128(alpha, mask)), half);
+
+		return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+	}
+
+	inline __m128i blendQuad(__m128i dest, __m128i source)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		__m128i low = blendPairs(_mm_unpacklo_epi8(dest, zero), _mm_unpacklo_epi8(source, zero));
+		__m128i high = blendPairs(_mm_unpackhi_epi8(dest, zero), _mm_unpackhi_epi8(source, zero));
+
+		return _mm_add_epi8(source, _mm_packus_epi16(low, high));
+	}
+#endif
+
+#if defined(__AVX2__)
+	inline __m256i blendOctet(__m256i dest, __m256i source)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i mask = _mm256_set1_epi16(0xff);
+		const __m256i half = _mm256_set1_epi16(0x80);
+
+		__m256i low = _mm256_unpacklo_epi8(dest, zero);
+		__m256i high = _mm256_unpackhi_epi8(dest, zero);
+		__m256i lowSource = _mm256_unpacklo_epi8(source, zero);
+		__m256i highSource = _mm256_unpackhi_epi8(source, zero);
+
+		__m256i lowAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lowSource, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		__m256i highAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(highSource, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+		low = _mm256_add_epi16(_mm256_mullo_epi16(low, _mm256_xor_si256(lowAlpha, mask)), half);
+		high = _mm256_add_epi16(_mm256_mullo_epi16(high, _mm256_xor_si256(highAlpha, mask)), half);
+
+		low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+		high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+
+		return _mm256_add_epi8(source, _mm256_packus_epi16(low, high));
+	}
+#endif
+}
+
+void PixelBlitter::blendRowScalar(uint32 *pDest, const uint32 *pSource, int count)
+{
+	for(int idx = 0; idx < count; idx++)
+		pDest[idx] = blendPixel(pDest[idx], pSource[idx]);
+}
+
+void PixelBlitter::blendRow(uint32 *pDest, const uint32 *pSource, int count)
+{
+	int idx = 0;
+
+	// the figures are mostly fully transparent or fully opaque, so those runs skip the arithmetic
+#if defined(__AVX2__)
+	const __m256i opaqueOctet = _mm256_set1_epi32(int(0xff000000));
+
+	for(; idx + 8 <= count; idx += 8)
+	{
+		__m256i source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSource + idx));
+		__m256i alpha = _mm256_and_si256(source, opaqueOctet);
+
+		if(_mm256_testz_si256(alpha, alpha))
+			continue;
+
+		if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, opaqueOctet)) == -1)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + idx), source);
+			continue;
+		}
+
+		__m256i dest = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDest + idx));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + idx), blendOctet(dest, source));
+	}
+#endif
+
+#if defined(__SSE2__)
+	const __m128i opaque = _mm_set1_epi32(int(0xff000000));
+	const __m128i zero = _mm_setzero_si128();
+
+	for(; idx + 4 <= count; idx += 4)
+	{
+		__m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + idx));
+		__m128i alpha = _mm_and_si128(source, opaque);
+
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xffff)
+			continue;
+
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, opaque)) == 0xffff)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + idx), source);
+			continue;
+		}
+
+		__m128i dest = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDest + idx));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + idx), blendQuad(dest, source));
+	}
+#endif
+
+	blendRowScalar(pDest + idx, pSource + idx, count - idx);
+}
+
+void PixelBlitter::blendImage(Image &dest, int x, int y, const Image &source)
+{
+	int left = jmax(0, x);
+	int top = jmax(0, y);
+	int right = jmin(dest.getWidth(), x + source.getWidth());
+	int bottom = jmin(dest.getHeight(), y + source.getHeight());
+
+	if(left >= right || top >= bottom)
+		return;
+
+	jassert(dest.isARGB() && source.isARGB());
+
+	int destStride = 0;
+	int sourceStride = 0;
+	int pixelStride = 0;
+
+	uint8 *pDest = dest.lockPixelDataReadWrite(left, top, right - left, bottom - top, destStride, pixelStride);
+	const uint8 *pSource = source.lockPixelDataReadOnly(left - x, top - y, right - left, bottom - top, sourceStride, pixelStride);
+
+	for(int row = 0; row < bottom - top; row++)
+		blendRow(reinterpret_cast<uint32*>(pDest + (row * destStride)), reinterpret_cast<const uint32*>(pSource + (row * sourceStride)), right - left);
+
+	source.releasePixelDataReadOnly(pSource);
+	dest.releasePixelDataReadWrite(pDest);
+}
+
+const char *PixelBlitter::getKernelName()
+{
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(__SSE2__)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
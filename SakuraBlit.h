@@ -0,0 +1,46 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+
+// Source-over compositing of premultiplied 32-bit ARGB pixels, as JUCE keeps them in an ARGB image:
+// d = s + d * (255 - sa) / 255, rounded the same way by every kernel.
+// The kernel is picked when compiling: AVX2 if the compiler targets it, SSE2 on any x86-64, plain C++ otherwise.
+class PixelBlitter
+{
+public:
+
+	static void blendRow(uint32 *pDest, const uint32 *pSource, int count);
+	static void blendRowScalar(uint32 *pDest, const uint32 *pSource, int count);
+
+	static void fillRow(uint32 *pDest, uint32 colour, int count)
+	{
+		for(int idx = 0; idx < count; idx++)
+			pDest[idx] = colour;
+	}
+
+	// Composites the whole source over the destination with its top-left corner at (x, y), clipped to the destination.
+	// Both have to be ARGB images.
+	static void blendImage(Image &dest, int x, int y, const Image &source);
+
+	static const char *getKernelName();
+};
@@ -0,0 +1,645 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraBoard.h"
+#include "SakuraLiveness.h"
+
+const int SakuraBoard::__dx[4] = { -1, 0, 1, 0 };
+const int SakuraBoard::__dy[4] = { 0, -1, 0, 1 };
+
+SakuraBoard::SakuraBoard() :
+	_livenessMode(bitParallelLiveness),
+	_pTiledLiveness(0),
+	_width(0),
+	_height(0),
+	_rootX(0),
+	_rootY(0),
+	_infiniteMode(false),
+	_relax(.0),
+	_seed(0),
+	_shuffleSeed(0),
+	_cellsOutOfPlace(0),
+	_forbiddenCells(CellsCoordsType::key_compare(), ArenaAllocator<std::pair<int, int> >(&_boardArena)),
+	_stateHash(0),
+	_puzzleHash(0),
+	_generationPhase(notGenerating),
+	_generationStep(0),
+	_generationSteps(0),
+	_grownCells(0)
+{
+}
+
+SakuraBoard::~SakuraBoard()
+{
+	delete _pTiledLiveness;
+}
+
+void SakuraBoard::resize(int width, int height)
+{
+	cancelBranch();
+
+	if(width == _width && height == _height)
+		return;
+
+	_width = width;
+	_height = height;
+
+	_cells.assign(width * height, Cell());
+	_live.assign(width * height, uint8(Dead));
+
+	_planes.resize(width, height);
+	_oneTurn.assign(_planes.getWordsPerRow() * height, uint64(0));
+	_twoTurns.assign(_planes.getWordsPerRow() * height, uint64(0));
+
+	_changedCells.clear();
+	_changedCells.reserve(width * height);
+
+	// a flood walk pushes every cell at most once, so the moves never grow it
+	_walkStack.clear();
+	_walkStack.reserve(width * height);
+
+	_rootX = std::min(_rootX, width - 1);
+	_rootY = std::min(_rootY, height - 1);
+	_cellsOutOfPlace = 0;
+
+	rehash();
+}
+
+void SakuraBoard::generateBranch(bool infiniteMode, double relax)
+{
+	generateBranch(infiniteMode, relax, makeSeed());
+}
+
+void SakuraBoard::generateBranch(bool infiniteMode, double relax, uint32 seed)
+{
+	SAKURA_TRACE_SCOPE("generateBranch");
+
+	beginBranch(infiniteMode, relax, seed);
+
+	while(continueBranch(0x7fffffff))
+		;
+}
+
+void SakuraBoard::beginBranch(bool infiniteMode, double relax, uint32 seed)
+{
+	_infiniteMode = infiniteMode;
+	_relax = relax;
+
+	_seed = seed;
+	std::srand(_seed);
+
+	for(std::vector<Cell>::iterator it = _cells.begin(), end = _cells.end(); it != end; ++it)
+		(*it).reset();
+
+	_forbiddenCells.clear();
+	_boardArena.release();
+	_generatorStack.clear();
+
+	_generationPhase = placingForbiddenCells;
+	_generationStep = 0;
+	_generationSteps = int(((_width * _height) * relax) + .5);
+	_grownCells = 0;
+}
+
+bool SakuraBoard::continueBranch(int maxSteps)
+{
+	int r_x = 0;
+	int r_y = 0;
+
+	while(maxSteps > 0)
+	{
+		switch(_generationPhase)
+		{
+		case notGenerating:
+			return false;
+
+		case placingForbiddenCells:
+			for(; _generationStep < _generationSteps && maxSteps > 0; _generationStep++, maxSteps--)
+				_forbiddenCells.insert(std::pair<int, int>(std::rand() % _width, std::rand() % _height));
+
+			if(_generationStep < _generationSteps)
+				return true;
+
+			_forbiddenCells.erase(std::pair<int, int>(_rootX, _rootY));
+			_forbiddenFilter = _forbiddenCells.begin();
+			_generationPhase = clearingAroundRoot;
+			break;
+
+		case clearingAroundRoot:
+			// the cell after an erased one is passed over, as it always was, so a seed still gives the same branch
+			for(; _forbiddenFilter != _forbiddenCells.end() && maxSteps > 0; maxSteps--)
+			{
+				CellsCoordsType::iterator it = _forbiddenFilter++;
+
+				if(std::abs(_rootX - (*it).first) <= _width / 2 && std::abs(_rootY - (*it).second) <= _height / 2)
+				{
+					_forbiddenCells.erase(it);
+
+					if(_forbiddenFilter != _forbiddenCells.end())
+						++_forbiddenFilter;
+				}
+			}
+
+			if(_forbiddenFilter != _forbiddenCells.end())
+				return true;
+
+			startGrowing(std::rand() % _width, std::rand() % _height);
+			break;
+
+		case growingBranch:
+			// depth-first walk that connects every free cell it reaches; each cell gets at most two new connections
+			// and its directions are tried starting from a random one
+			for(; !_generatorStack.empty() && maxSteps > 0; maxSteps--)
+			{
+				GeneratorFrame &top = _generatorStack.back();
+
+				if(top.direction >= 4 || !top.connectionsLeft)
+				{
+					_generatorStack.pop_back();
+					continue;
+				}
+
+				int r_direction = (top.direction++ + top.shiftStart) % 4;
+				Cell &cell = getCell(top.x, top.y);
+
+				if(cell.getDirection(r_direction) || !getNeighbour(top.x, top.y, r_direction, r_x, r_y))
+					continue;
+
+				Cell &nextCell = getCell(r_x, r_y);
+
+				if(nextCell.notEmpty() || _forbiddenCells.find(std::pair<int, int>(r_x, r_y)) != _forbiddenCells.end())
+					continue;
+
+				cell.setDirection(r_direction, true);
+				nextCell.setDirection((r_direction + 2) % 4, true);
+
+				top.connectionsLeft--;
+
+				GeneratorFrame next = { r_x, r_y, std::rand() % 4, 0, 2 };
+				_generatorStack.push_back(next);
+				_grownCells++;
+			}
+
+			if(!_generatorStack.empty())
+				return true;
+
+			_generationPhase = loadingBitplanes;
+			_generationStep = 0;
+			_stateHash = _puzzleHash = getBoardKey();
+			break;
+
+		case loadingBitplanes:
+			// a row per step, hashed on the way; the branch isn't shuffled yet, so both hashes are the same
+			for(; _generationStep < _height && maxSteps > 0; _generationStep++, maxSteps--)
+				for(int x = 0, cellIndex = _generationStep * _width; x < _width; x++, cellIndex++)
+				{
+					int mask = _cells[cellIndex].getMask(true);
+
+					_planes.setMasks(x, _generationStep, mask, mask);
+					_puzzleHash ^= getCellKey(cellIndex, mask);
+				}
+
+			_stateHash = _puzzleHash;
+
+			if(_generationStep < _height)
+				return true;
+
+			positionRoot();
+
+			setAllCellsLive(Alive);
+			_changedCells.clear();
+			_cellsOutOfPlace = 0;
+			_journal.clear();
+
+			_generationPhase = notGenerating;
+
+			return false;
+		}
+	}
+
+	return _generationPhase != notGenerating;
+}
+
+void SakuraBoard::startGrowing(int x, int y)
+{
+	GeneratorFrame frame = { x, y, std::rand() % 4, 0, 2 };
+
+	_generatorStack.clear();
+	_generatorStack.push_back(frame);
+
+	_generationPhase = growingBranch;
+}
+
+void SakuraBoard::cancelBranch()
+{
+	_generatorStack.clear();
+	_generationPhase = notGenerating;
+}
+
+double SakuraBoard::getGenerationProgress() const
+{
+	switch(_generationPhase)
+	{
+	case placingForbiddenCells:
+		return _generationSteps ? (.05 * _generationStep) / _generationSteps : .0;
+
+	case clearingAroundRoot:
+		return .05;
+
+	case growingBranch:
+		return .1 + (.8 * std::min(1., double(_grownCells) / std::max(1, getNumCells() - int(_forbiddenCells.size()))));
+
+	case loadingBitplanes:
+		return .9 + ((.1 * _generationStep) / std::max(1, _height));
+
+	default:
+		return .0;
+	}
+}
+
+void SakuraBoard::rehash()
+{
+	_stateHash = _puzzleHash = getBoardKey();
+
+	for(int cellIndex = 0, count = getNumCells(); cellIndex < count; cellIndex++)
+	{
+		_stateHash ^= getCellKey(cellIndex, _cells[cellIndex].getMask(false));
+		_puzzleHash ^= getCellKey(cellIndex, _cells[cellIndex].getMask(true));
+	}
+}
+
+void SakuraBoard::loadBitplanes()
+{
+	for(int y = 0, cellIndex = 0; y < _height; y++)
+		for(int x = 0; x < _width; x++, cellIndex++)
+			_planes.setMasks(x, y, _cells[cellIndex].getMask(true), _cells[cellIndex].getMask(false));
+}
+
+bool SakuraBoard::positionRoot()
+{
+	_rootX = _width / 2;
+	_rootY = _height / 2;
+
+	if(getCell(_rootX, _rootY).count() < 2)
+	{
+		for(int y_clip_top = _rootY - ((_height & 1) ? 0 : 1), y_clip_bottom = _rootY,
+				x_clip_left = _rootX - ((_width & 1) ? 0 : 1), x_clip_right = _rootX;
+				y_clip_top >= 0 && x_clip_left >= 0;
+				y_clip_top--, y_clip_bottom++, x_clip_left--, x_clip_right++)
+		{
+			for(int y_ = y_clip_top; y_ <= y_clip_bottom; y_++)
+			{
+				for(int x_ = x_clip_left; x_ <= x_clip_right; x_++)
+				{
+					if(getCell(x_, y_).count() >= 2)
+					{
+						_rootX = x_;
+						_rootY = y_;
+
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+void SakuraBoard::shuffle()
+{
+	shuffle(makeSeed());
+}
+
+// The turns are drawn cell by cell in the same order as ever, so a seed still gives the same shuffle,
+// but they are applied to the bitplanes in one pass and only the result is copied back to the cells.
+void SakuraBoard::shuffle(uint32 seed)
+{
+	_shuffleSeed = seed;
+	std::srand(_shuffleSeed);
+
+	int wordsPerRow = _planes.getWordsPerRow();
+
+	do
+	{
+		std::fill(_oneTurn.begin(), _oneTurn.end(), uint64(0));
+		std::fill(_twoTurns.begin(), _twoTurns.end(), uint64(0));
+
+		for(int y = 0; y < _height; y++)
+			for(int x = 0; x < _width; x++)
+			{
+				bool left = (std::rand() % 2) == 0;
+				int count = std::rand() % 4;
+
+				if(!(count & 1) && !left)
+					count = (count + 1) % 4;
+
+				int leftTurns = left ? count : (4 - count) & 3;
+				uint64 bit = uint64(1) << (x & 63);
+				int word = (y * wordsPerRow) + (x >> 6);
+
+				if(leftTurns & 1)
+					_oneTurn[word] |= bit;
+
+				if(leftTurns & 2)
+					_twoTurns[word] |= bit;
+			}
+
+		_planes.rotateLeft(_oneTurn, _twoTurns);
+	}
+	while(_planes.isAllInPlace());
+
+	for(int y = 0, cellIndex = 0; y < _height; y++)
+		for(int x = 0; x < _width; x++, cellIndex++)
+			_cells[cellIndex].setMasks(_cells[cellIndex].getMask(true), _planes.getMask(x, y));
+
+	rehash();
+
+	drawAlivePath();
+	countCellsOutOfPlace();
+
+	_journal.clear();
+}
+
+// Marks every cell connected to the given one. A cell is marked before its neighbours are looked at,
+// so a loop made by the shuffled cells doesn't walk forever.
+void SakuraBoard::setupLive(int cellIndex)
+{
+	if(_live[cellIndex] || _cells[cellIndex].empty())
+		return;
+
+	_walkStack.clear();
+	_walkStack.push_back(cellIndex);
+
+	int r_x = 0;
+	int r_y = 0;
+
+	while(!_walkStack.empty())
+	{
+		int index = _walkStack.back();
+		_walkStack.pop_back();
+
+		const Cell &cell = _cells[index];
+		int x = index % _width;
+		int y = index / _width;
+
+		for(int direction = 0; direction < 4; direction++)
+		{
+			if(!cell.getDirection(direction) || !getNeighbour(x, y, direction, r_x, r_y))
+				continue;
+
+			int nextIndex = (r_y * _width) + r_x;
+
+			if(!_cells[nextIndex].getDirection((direction + 2) % 4))
+				continue;
+
+			enliven(index);
+
+			if(!_live[nextIndex])
+			{
+				enliven(nextIndex);
+
+				_walkStack.push_back(nextIndex);
+			}
+		}
+	}
+}
+
+void SakuraBoard::drawAlivePath()
+{
+	SAKURA_PROFILE_SCOPE(alivePath);
+	SAKURA_TRACE_SCOPE("drawAlivePath");
+
+	_changedCells.clear();
+
+	if(_livenessMode == floodLiveness)
+	{
+		setAllCellsLive(Dead);
+
+		setupLive((_rootY * _width) + _rootX);
+
+		return;
+	}
+
+	if(_livenessMode == tiledLiveness)
+	{
+		if(!_pTiledLiveness)
+			_pTiledLiveness = new TiledLiveness();
+
+		_pTiledLiveness->compute(_planes, _rootX, _rootY, _infiniteMode, _livePlane);
+	}
+	else
+		_planes.propagateLive(_rootX, _rootY, _infiniteMode, _livePlane);
+
+	std::vector<uint64>::const_iterator word = _livePlane.begin();
+
+	for(int y = 0, cellIndex = 0; y < _height; y++)
+		for(int x = 0; x < _width; x += 64, ++word)
+		{
+			uint64 bits = *word;
+
+			for(int end = cellIndex + std::min(64, _width - x); cellIndex < end; cellIndex++, bits >>= 1)
+			{
+				_live[cellIndex] = uint8(bits & 1);
+
+				if(bits & 1)
+					_changedCells.push_back(cellIndex);
+			}
+		}
+}
+
+// A dead cell can only join the live branch by turning, so growing the branch from it is enough.
+// A live cell may cut a part of the branch off, so then the whole path is traced again from the root.
+bool SakuraBoard::turnCell(int cellIndex, int leftTurns)
+{
+	leftTurns &= 3;
+
+	if(!leftTurns)
+		return false;
+
+	Cell &cell = _cells[cellIndex];
+
+	{
+		SAKURA_PROFILE_SCOPE(rotate);
+
+		bool wasInPlace = cell.isInPlace();
+		int mask = cell.getMask(false);
+
+		for(int idx = 0; idx < leftTurns; idx++)
+			cell.rotate(true);
+
+		_cellsOutOfPlace += (wasInPlace ? 1 : 0) - (cell.isInPlace() ? 1 : 0);
+		_stateHash ^= getCellKey(cellIndex, mask) ^ getCellKey(cellIndex, cell.getMask(false));
+
+		_planes.setMasks(cellIndex % _width, cellIndex / _width, cell.getMask(true), cell.getMask(false));
+	}
+
+	SAKURA_PROFILE_SCOPE(liveness);
+
+	int rootIndex = (_rootY * _width) + _rootX;
+
+	if(_live[cellIndex] || cellIndex == rootIndex || !_live[rootIndex])
+	{
+		drawAlivePath();
+
+		return true;
+	}
+
+	int x = cellIndex % _width;
+	int y = cellIndex / _width;
+	int r_x = 0;
+	int r_y = 0;
+	bool touchesBranch = false;
+
+	for(int direction = 0; direction < 4 && !touchesBranch; direction++)
+	{
+		if(!cell.getDirection(direction) || !getNeighbour(x, y, direction, r_x, r_y))
+			continue;
+
+		int nextIndex = (r_y * _width) + r_x;
+
+		touchesBranch = _live[nextIndex] && _cells[nextIndex].getDirection((direction + 2) % 4);
+	}
+
+	if(touchesBranch)
+		setupLive(cellIndex);
+
+	return false;
+}
+
+int SakuraBoard::undoMove(bool &retraced)
+{
+	retraced = false;
+
+	if(!_journal.canUndo())
+		return -1;
+
+	int cellIndex = 0;
+	int leftTurns = 0;
+
+	_journal.undo(cellIndex, leftTurns);
+
+	retraced = turnCell(cellIndex, 4 - leftTurns);
+
+	return cellIndex;
+}
+
+int SakuraBoard::redoMove(bool &retraced)
+{
+	retraced = false;
+
+	if(!_journal.canRedo())
+		return -1;
+
+	int cellIndex = 0;
+	int leftTurns = 0;
+
+	_journal.redo(cellIndex, leftTurns);
+
+	retraced = turnCell(cellIndex, leftTurns);
+
+	return cellIndex;
+}
+
+bool SakuraBoard::isAllCellsInPlace() const
+{
+	return _planes.isAllInPlace();
+}
+
+void SakuraBoard::countCellsOutOfPlace()
+{
+	_cellsOutOfPlace = _planes.countOutOfPlace();
+}
+
+size_t SakuraBoard::getMemoryUsage() const
+{
+	return (_cells.capacity() * sizeof(Cell)) +
+		_live.capacity() +
+		((_changedCells.capacity() + _walkStack.capacity()) * sizeof(int)) +
+		(_generatorStack.capacity() * sizeof(GeneratorFrame)) +
+		_planes.getMemoryUsage() +
+		((_oneTurn.capacity() + _twoTurns.capacity() + _livePlane.capacity()) * sizeof(uint64)) +
+		_journal.getMemoryUsage() +
+		_boardArena.getReservedBytes() +
+		(_pTiledLiveness ? _pTiledLiveness->getMemoryUsage() : 0);
+}
+
+void SakuraBoard::getState(BoardState &state) const
+{
+	state.width = _width;
+	state.height = _height;
+	state.rootX = _rootX;
+	state.rootY = _rootY;
+	state.infiniteMode = _infiniteMode;
+	state.relax = _relax;
+	state.seed = _seed;
+
+	state.cells.resize(_cells.size());
+
+	std::vector<uint8>::iterator cell = state.cells.begin();
+
+	for(std::vector<Cell>::const_iterator it = _cells.begin(), end = _cells.end(); it != end; ++it, ++cell)
+		*cell = uint8((*it).getMask(true) | ((*it).getMask(false) << 4));
+}
+
+void SakuraBoard::setState(const BoardState &header, const uint8 *pCells)
+{
+	resize(header.width, header.height);
+
+	_rootX = header.rootX;
+	_rootY = header.rootY;
+	_infiniteMode = header.infiniteMode;
+	_relax = header.relax;
+	_seed = header.seed;
+
+	for(std::vector<Cell>::iterator it = _cells.begin(), end = _cells.end(); it != end; ++it, ++pCells)
+		(*it).setMasks(*pCells & 0x0f, *pCells >> 4);
+
+	loadBitplanes();
+	rehash();
+	countCellsOutOfPlace();
+	_journal.clear();
+}
+
+void SakuraBoard::setPuzzle(const PuzzleRecord &record)
+{
+	resize(record.width, record.height);
+
+	_rootX = record.rootX;
+	_rootY = record.rootY;
+	_infiniteMode = record.infiniteMode;
+	_relax = record.relax;
+	_seed = record.seed;
+
+	for(int cellIndex = 0, count = getNumCells(); cellIndex < count; cellIndex++)
+	{
+		int mask = record.getMask(cellIndex);
+
+		_cells[cellIndex].setMasks(mask, mask);
+	}
+
+	loadBitplanes();
+	rehash();
+
+	setAllCellsLive(Alive);
+	_changedCells.clear();
+	_cellsOutOfPlace = 0;
+	_journal.clear();
+}
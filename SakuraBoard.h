@@ -0,0 +1,787 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+#include "SakuraMemory.h"
+#include "SakuraStorage.h"
+#include "SakuraProfiling.h"
+#include "SakuraTrace.h"
+#include "SakuraBitplanes.h"
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <sstream>
+#include <functional>
+#include <cstdlib>
+
+namespace Direction
+{
+	enum direction
+	{
+		Left = 0,
+		Top,
+		Right,
+		Bottom
+	};
+}
+
+typedef std::deque<bool> DirectionSetType;
+
+// The directions are packed into the lower four bits of a byte, bit N standing for Direction N.
+// This keeps a cell free of any heap storage; DirectionSetType is only built on request.
+class CellDirections
+{
+private:
+
+	unsigned char _mask;
+
+	static int countBits(unsigned char mask)
+	{
+		static const int __bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+		return __bits[mask & 0x0f];
+	}
+
+public:
+
+	CellDirections() : _mask(0)
+	{
+	}
+
+	CellDirections(const CellDirections &copy) : _mask(copy._mask)
+	{
+	}
+
+	CellDirections(const DirectionSetType &directionsCopy) : _mask(0)
+	{
+		for(int direction = 0, size = std::min(int(directionsCopy.size()), 4); direction < size; direction++)
+			setDirection(direction, directionsCopy[direction]);
+	}
+
+	CellDirections &operator = (const CellDirections &copy)
+	{
+		_mask = copy._mask;
+
+		return *this;
+	}
+
+	DirectionSetType getDirections() const
+	{
+		DirectionSetType directions(4, false);
+
+		for(int direction = 0; direction < 4; direction++)
+			directions[direction] = getDirection(direction);
+
+		return directions;
+	}
+
+	int getMask() const
+	{
+		return _mask;
+	}
+
+	void setMask(int mask)
+	{
+		_mask = (unsigned char)(mask & 0x0f);
+	}
+
+	void setDirection(int direction, const bool value)
+	{
+		if(value)
+			_mask |= (1 << direction);
+		else
+			_mask &= ~(1 << direction);
+	}
+
+	bool getDirection(int direction) const
+	{
+		return (_mask >> direction) & 1;
+	}
+
+	void rotate(const bool left = true)
+	{
+		if(left)
+			_mask = (unsigned char)((_mask >> 1) | ((_mask & 1) << 3));
+		else
+			_mask = (unsigned char)(((_mask << 1) & 0x0f) | (_mask >> 3));
+	}
+
+	void reset()
+	{
+		_mask = 0;
+	}
+
+	bool empty() const
+	{
+		return _mask == 0;
+	}
+
+	bool notEmpty() const
+	{
+		return !empty();
+	}
+
+	int count(bool value = true) const
+	{
+		return value ? countBits(_mask) : 4 - countBits(_mask);
+	}
+
+	std::string to_string()
+	{
+		return dump();
+	}
+
+	bool operator == (const CellDirections &directions) const
+	{
+		return _mask == directions._mask;
+	}
+
+	std::pair<int, int> getConnectionType() const
+	{
+		int type(count(true));
+		int sub_type(0); // straight
+
+		if(type == 2 && _mask != 0x05 && _mask != 0x0a)
+			sub_type = 1; // gay
+
+		return std::pair<int, int>(type, sub_type);
+	}
+
+	std::string dump(bool add_end_of_line = false) const
+	{
+		std::string s(4, '0');
+
+		for(int direction = 0; direction < 4; direction++)
+			if(getDirection(direction))
+				s[direction] = '1';
+
+		if(add_end_of_line)
+			s += '\n';
+
+		return s;
+	}
+
+	std::string dumpLevel(const int level)
+	{
+		std::stringstream s;
+
+		if(empty())
+		{
+			s << "`" << "`" << "`";
+		}
+		else
+		{
+			switch(level)
+			{
+			case 0:
+				s << " " << (getDirection(1) ? "*" : " ") << " ";
+				break;
+
+			case 1:
+				s << (getDirection(0) ? "*" : " ") << (notEmpty() ? "*" : " ") << (getDirection(2) ? "*" : " ");
+				break;
+
+			case 2:
+				s << " " << (getDirection(3) ? "*" : " ") << " ";
+				break;
+			}
+		}
+
+		return s.str();
+	}
+};
+
+class Cell
+{
+protected:
+
+	CellDirections _originalState;
+	CellDirections _currentState;
+
+public:
+
+	Cell()
+	{
+	}
+
+	DirectionSetType getDirections(bool original = false) const
+	{
+		if(original)
+			return _originalState.getDirections();
+
+		return _currentState.getDirections();
+	}
+
+	int getMask(bool original = false) const
+	{
+		if(original)
+			return _originalState.getMask();
+
+		return _currentState.getMask();
+	}
+
+	void putInPlace()
+	{
+		_currentState = _originalState;
+	}
+
+	bool isInPlace() const
+	{
+		return (_currentState == _originalState);
+	}
+
+	int getLeftTurnsToPlace() const
+	{
+		CellDirections state(_currentState);
+
+		for(int turns = 0; turns < 4; turns++, state.rotate(true))
+			if(state == _originalState)
+				return turns;
+
+		return 0;
+	}
+
+	void rotate(bool left = true)
+	{
+		_currentState.rotate(left);
+	}
+
+	void reset()
+	{
+		_originalState.reset();
+		_currentState.reset();
+	}
+
+	void setDirection(int direction, const bool value)
+	{
+		_originalState.setDirection(direction, value);
+		_currentState.setDirection(direction, value);
+	}
+
+	void setMasks(int original, int current)
+	{
+		_originalState.setMask(original);
+		_currentState.setMask(current);
+	}
+
+	void setDirection(int direction, const bool value, const bool original)
+	{
+		if(original)
+			_originalState.setDirection(direction, value);
+		else
+			_currentState.setDirection(direction, value);
+	}
+
+	bool getDirection(int direction, bool original = false) const
+	{
+		if(original)
+			return _originalState.getDirection(direction);
+
+		return _currentState.getDirection(direction);
+	}
+
+	std::pair<int, int> getConnectionType(bool original = false) const
+	{
+		if(original)
+			return _originalState.getConnectionType();
+
+		return _currentState.getConnectionType();
+	}
+
+	bool empty() const
+	{
+		return _originalState.empty();
+	}
+
+	bool notEmpty() const
+	{
+		return _originalState.notEmpty();
+	}
+
+	int count(bool original = false, bool value = true) const
+	{
+		if(original)
+			return _originalState.count(value);
+
+		return _currentState.count(value);
+	}
+
+	std::string to_string(bool original = false)
+	{
+		if(original)
+			return _originalState.to_string();
+
+		return _currentState.to_string();
+	}
+
+	std::string dump(bool add_end_of_line = false, bool original = false) const
+	{
+		if(original)
+			return _originalState.dump(add_end_of_line);
+
+		return _currentState.dump(add_end_of_line);
+	}
+
+	std::string dumpLevel(const int level, bool original = false)
+	{
+		if(original)
+			return _originalState.dumpLevel(level);
+
+		return _currentState.dumpLevel(level);
+	}
+};
+
+// Append-only record of the moves made on the current board.
+// Every move takes four bytes: the cell index shifted left by two and the number of left quarter-turns (1..3)
+// the cell went through, so undo and redo never need a snapshot of the board.
+class MoveJournal
+{
+private:
+
+	std::vector<uint32> _moves;
+	size_t _position;
+
+public:
+
+	MoveJournal() : _position(0)
+	{
+	}
+
+	void clear()
+	{
+		_moves.clear();
+		_position = 0;
+	}
+
+	void record(int cellIndex, int leftTurns)
+	{
+		leftTurns &= 3;
+
+		if(!leftTurns)
+			return;
+
+		_moves.resize(_position);
+		_moves.push_back((uint32(cellIndex) << 2) | uint32(leftTurns));
+		_position = _moves.size();
+	}
+
+	bool canUndo() const
+	{
+		return _position > 0;
+	}
+
+	bool canRedo() const
+	{
+		return _position < _moves.size();
+	}
+
+	// Returns the move to take back; the cell has to be turned left by (4 - leftTurns) to get there.
+	void undo(int &cellIndex, int &leftTurns)
+	{
+		uint32 move = _moves[--_position];
+
+		cellIndex = int(move >> 2);
+		leftTurns = int(move & 3);
+	}
+
+	void redo(int &cellIndex, int &leftTurns)
+	{
+		uint32 move = _moves[_position++];
+
+		cellIndex = int(move >> 2);
+		leftTurns = int(move & 3);
+	}
+
+	size_t size() const
+	{
+		return _moves.size();
+	}
+
+	size_t getPosition() const
+	{
+		return _position;
+	}
+
+	size_t getMemoryUsage() const
+	{
+		return _moves.capacity() * sizeof(uint32);
+	}
+};
+
+class TiledLiveness;
+
+// The game board without any user interface: cell directions, the live branch and everything that generates,
+// shuffles and checks a branch. SakuraMatrix shows one of these; the benchmarks drive it directly.
+class SakuraBoard
+{
+public:
+
+	enum CellState
+	{
+		Dead = 0,
+		Alive = 1,
+		Solved = 2
+	};
+
+	// How drawAlivePath() traces the branch again: cell by cell, a bitplane word at a time,
+	// or in bands of rows on a pool of threads.
+	// The tiled mode is experimental: the game never selects it, only SakuraBench times it and checks it against the flood fill.
+	enum LivenessMode
+	{
+		floodLiveness,
+		bitParallelLiveness,
+		tiledLiveness
+	};
+
+private:
+
+	typedef std::set<std::pair<int, int>, std::less<std::pair<int, int> >, ArenaAllocator<std::pair<int, int> > > CellsCoordsType;
+
+	// One pending call of the branch generator; kept on an explicit stack so big boards don't run out of call stack.
+	struct GeneratorFrame
+	{
+		int x;
+		int y;
+		int shiftStart;
+		int direction;
+		int connectionsLeft;
+	};
+
+	// Where a branch generation run a slice at a time has got to.
+	enum GenerationPhase
+	{
+		notGenerating,
+		placingForbiddenCells,
+		clearingAroundRoot,
+		growingBranch,
+		loadingBitplanes
+	};
+
+	static const int __dx[4];
+	static const int __dy[4];
+
+	std::vector<Cell> _cells;
+	std::vector<uint8> _live;
+	std::vector<int> _changedCells;
+	std::vector<int> _walkStack;
+	std::vector<GeneratorFrame> _generatorStack;
+
+	// a copy of the cell directions for the whole-board checks, kept in step with _cells
+	BoardBitplanes _planes;
+	std::vector<uint64> _oneTurn;
+	std::vector<uint64> _twoTurns;
+	std::vector<uint64> _livePlane;
+	LivenessMode _livenessMode;
+	TiledLiveness *_pTiledLiveness;
+
+	int _width;
+	int _height;
+	int _rootX;
+	int _rootY;
+	bool _infiniteMode;
+	double _relax;
+	uint32 _seed;
+	uint32 _shuffleSeed;
+	int _cellsOutOfPlace;
+
+	MoveJournal _journal;
+
+	BoardArena _boardArena;
+	CellsCoordsType _forbiddenCells;
+
+	// Zobrist hashes, the xor of a key per cell and mask (and one for the size and mode),
+	// over the current masks and over the original ones
+	uint64 _stateHash;
+	uint64 _puzzleHash;
+
+	GenerationPhase _generationPhase;
+	int _generationStep;
+	int _generationSteps;
+	int _grownCells;
+	CellsCoordsType::iterator _forbiddenFilter;
+
+	void enliven(int cellIndex)
+	{
+		if(!_live[cellIndex])
+		{
+			_live[cellIndex] = uint8(Alive);
+
+			_changedCells.push_back(cellIndex);
+		}
+	}
+
+	void setupLive(int cellIndex);
+	void startGrowing(int x, int y);
+	void loadBitplanes();
+	void rehash();
+
+	// The keys are mixed from the cell index and the mask (splitmix64's finaliser) rather than kept in a table,
+	// which would be 16 words a cell.
+	static uint64 mixKey(uint64 key)
+	{
+		key += 0x9e3779b97f4a7c15ULL;
+		key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+
+		return key ^ (key >> 31);
+	}
+
+	static uint64 getCellKey(int cellIndex, int mask)
+	{
+		return mixKey((uint64(cellIndex) << 4) | uint64(mask));
+	}
+
+	uint64 getBoardKey() const
+	{
+		return mixKey(~((uint64(_width) << 32) | (uint64(_height) << 1) | (_infiniteMode ? 1 : 0)));
+	}
+
+	SakuraBoard(const SakuraBoard &);
+	SakuraBoard &operator = (const SakuraBoard &);
+
+public:
+
+	SakuraBoard();
+	~SakuraBoard();
+
+	void resize(int width, int height);
+
+	int getWidth() const
+	{
+		return _width;
+	}
+
+	int getHeight() const
+	{
+		return _height;
+	}
+
+	int getNumCells() const
+	{
+		return int(_cells.size());
+	}
+
+	int getRootX() const
+	{
+		return _rootX;
+	}
+
+	int getRootY() const
+	{
+		return _rootY;
+	}
+
+	// The next branch grows around the root, so a replayed generation has to start from the recorded one.
+	void setRoot(int x, int y)
+	{
+		_rootX = x;
+		_rootY = y;
+	}
+
+	bool isInfiniteMode() const
+	{
+		return _infiniteMode;
+	}
+
+	uint32 getSeed() const
+	{
+		return _seed;
+	}
+
+	uint32 getShuffleSeed() const
+	{
+		return _shuffleSeed;
+	}
+
+	double getRelax() const
+	{
+		return _relax;
+	}
+
+	int getCellsOutOfPlace() const
+	{
+		return _cellsOutOfPlace;
+	}
+
+	// The hash of the current orientations, kept up to date in O(1) a turn, and the hash of the puzzle,
+	// the original masks; they are equal for a board in place. The size and the mode are hashed in,
+	// the root and the live states aren't. Neither is kept while a branch is half-generated.
+	uint64 getStateHash() const
+	{
+		return _stateHash;
+	}
+
+	uint64 getPuzzleHash() const
+	{
+		return _puzzleHash;
+	}
+
+	Cell &getCell(int x, int y)
+	{
+		return _cells[(y * _width) + x];
+	}
+
+	const Cell &getCell(int x, int y) const
+	{
+		return _cells[(y * _width) + x];
+	}
+
+	Cell &getCell(int cellIndex)
+	{
+		return _cells[cellIndex];
+	}
+
+	LivenessMode getLivenessMode() const
+	{
+		return _livenessMode;
+	}
+
+	void setLivenessMode(LivenessMode mode)
+	{
+		_livenessMode = mode;
+	}
+
+	const BoardBitplanes &getBitplanes() const
+	{
+		return _planes;
+	}
+
+	int getLive(int x, int y) const
+	{
+		return _live[(y * _width) + x];
+	}
+
+	const std::vector<Cell> &getCells() const
+	{
+		return _cells;
+	}
+
+	const std::vector<uint8> &getLiveStates() const
+	{
+		return _live;
+	}
+
+	void setAllCellsLive(int live)
+	{
+		std::fill(_live.begin(), _live.end(), uint8(live));
+	}
+
+	// Finds the cell next to (x, y) in the given direction, wrapping around in infinite mode.
+	bool getNeighbour(int x, int y, int direction, int &nx, int &ny) const
+	{
+		nx = x + __dx[direction];
+		ny = y + __dy[direction];
+
+		if(nx < 0 || ny < 0 || nx >= _width || ny >= _height)
+		{
+			if(!_infiniteMode)
+				return false;
+
+			nx = (nx + _width) % _width;
+			ny = (ny + _height) % _height;
+		}
+
+		return true;
+	}
+
+	// The cells whose live state changed since the last call of clearChangedCells().
+	const std::vector<int> &getChangedCells() const
+	{
+		return _changedCells;
+	}
+
+	void clearChangedCells()
+	{
+		_changedCells.clear();
+	}
+
+	static uint32 makeSeed()
+	{
+		return (uint32(std::rand()) << 15) ^ uint32(std::rand());
+	}
+
+	// The same seed (and the same root left by the previous branch) always gives the same branch.
+	void generateBranch(bool infiniteMode, double relax, uint32 seed);
+	void generateBranch(bool infiniteMode, double relax);
+
+	// The same branch in steps: continueBranch() does at most the given number of steps and returns true
+	// while there's more to do. The random sequence is std::rand()'s, so nothing else on the generating thread
+	// may use it until the branch is finished or cancelled.
+	void beginBranch(bool infiniteMode, double relax, uint32 seed);
+	bool continueBranch(int maxSteps);
+
+	// Drops an unfinished branch; the cells are left half-made until the next branch or setState().
+	void cancelBranch();
+
+	bool isGenerating() const
+	{
+		return _generationPhase != notGenerating;
+	}
+
+	// 0 to 1, a rough guess: the walk is weighed by the cells it has grown into.
+	double getGenerationProgress() const;
+
+	bool positionRoot();
+	void shuffle(uint32 seed);
+	void shuffle();
+	void drawAlivePath();
+
+	// Returns true if the whole path was traced again, otherwise only getChangedCells() have changed.
+	bool turnCell(int cellIndex, int leftTurns);
+
+	// A player's move: turns the cell and records it in the journal.
+	bool rotateCell(int cellIndex, int leftTurns)
+	{
+		SAKURA_TRACE_SCOPE_ARG("rotateCell", cellIndex);
+
+		_journal.record(cellIndex, leftTurns);
+
+		return turnCell(cellIndex, leftTurns);
+	}
+
+	// Take back or repeat a move; return the index of the turned cell, or -1 if there was nothing to do.
+	int undoMove(bool &retraced);
+	int redoMove(bool &retraced);
+
+	void clearJournal()
+	{
+		_journal.clear();
+	}
+
+	bool isAllCellsInPlace() const;
+	void countCellsOutOfPlace();
+
+	bool isSolved() const
+	{
+		return !_cellsOutOfPlace && isAllCellsInPlace();
+	}
+
+	// Bytes held by the board's own containers and arena.
+	size_t getMemoryUsage() const;
+
+	void getState(BoardState &state) const;
+	void setState(const BoardState &header, const uint8 *pCells);
+	void setPuzzle(const PuzzleRecord &record);
+};
@@ -0,0 +1,257 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraCodec.h"
+
+namespace
+{
+	enum
+	{
+		maskLeft = 1,
+		maskTop = 2,
+		maskRight = 4,
+		maskBottom = 8
+	};
+
+	int rotateLeft(int mask)
+	{
+		return ((mask >> 1) | ((mask & 1) << 3)) & 0x0f;
+	}
+
+	// 1 for a cross, 2 for a straight line, 4 for everything else.
+	int rotationPeriod(int mask)
+	{
+		int rotated = rotateLeft(mask);
+
+		if(rotated == mask)
+			return 1;
+
+		return (rotateLeft(rotated) == mask) ? 2 : 4;
+	}
+
+	// Shape classes for the shuffle contexts: end, straight, corner, tee.
+	int shapeClass(int mask)
+	{
+		static const int __bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+		int count = __bits[mask];
+
+		if(count == 2)
+			return (mask == 0x05 || mask == 0x0a) ? 1 : 2;
+
+		return (count == 1) ? 0 : 3;
+	}
+
+	struct EdgeModels
+	{
+		BitModel right[8];
+		BitModel bottom[8];
+		BitModel turns[4][3];
+	};
+}
+
+bool PuzzleCodec::encode(const BoardState &state, bool withShuffle, std::vector<uint8> &out)
+{
+	int width = state.width;
+	int height = state.height;
+
+	if(width < 3 || height < 3 || int(state.cells.size()) != width * height)
+		return false;
+
+	// every connection has to be reciprocal, and a regular board can't lead out of its edges
+	for(int y = 0; y < height; y++)
+		for(int x = 0; x < width; x++)
+		{
+			int mask = state.cells[(y * width) + x] & 0x0f;
+			int right = state.cells[(y * width) + ((x + 1) % width)] & 0x0f;
+			int bottom = state.cells[(((y + 1) % height) * width) + x] & 0x0f;
+
+			if(((mask & maskRight) != 0) != ((right & maskLeft) != 0) || ((mask & maskBottom) != 0) != ((bottom & maskTop) != 0))
+				return false;
+
+			if(!state.infiniteMode && (((mask & maskRight) && x == width - 1) || ((mask & maskBottom) && y == height - 1)))
+				return false;
+		}
+
+	out.clear();
+	out.push_back(uint8((state.infiniteMode ? infiniteModeFlag : 0) | (withShuffle ? shuffleFlag : 0)));
+	writeVarInt(out, uint32(width));
+	writeVarInt(out, uint32(height));
+	writeVarInt(out, uint32(state.rootX));
+	writeVarInt(out, uint32(state.rootY));
+	writeVarInt(out, uint32(state.relax * 1000. + .5));
+	writeVarInt(out, state.seed);
+
+	EdgeModels models;
+	RangeEncoder encoder(out);
+
+	// the contexts may only use the connections the decoder has already seen, so they are mirrored here
+	std::vector<uint8> known(state.cells.size(), 0);
+
+	for(int y = 0; y < height; y++)
+		for(int x = 0; x < width; x++)
+		{
+			int mask = state.cells[(y * width) + x] & 0x0f;
+			uint8 &cell = known[(y * width) + x];
+			int context = ((cell & maskLeft) ? 1 : 0) | ((cell & maskTop) ? 2 : 0);
+
+			if(state.infiniteMode || x < width - 1)
+			{
+				int upperRight = (y > 0) ? known[((y - 1) * width) + ((x + 1) % width)] : 0;
+
+				encoder.encode(models.right[context | ((upperRight & maskBottom) ? 4 : 0)], (mask & maskRight) ? 1 : 0);
+
+				if(mask & maskRight)
+				{
+					cell |= maskRight;
+					known[(y * width) + ((x + 1) % width)] |= maskLeft;
+				}
+			}
+
+			if(state.infiniteMode || y < height - 1)
+			{
+				encoder.encode(models.bottom[context | ((mask & maskRight) ? 4 : 0)], (mask & maskBottom) ? 1 : 0);
+
+				if(mask & maskBottom)
+				{
+					cell |= maskBottom;
+					known[(((y + 1) % height) * width) + x] |= maskTop;
+				}
+			}
+		}
+
+	if(withShuffle)
+	{
+		for(std::vector<uint8>::const_iterator it = state.cells.begin(), end = state.cells.end(); it != end; ++it)
+		{
+			int original = *it & 0x0f;
+			int current = *it >> 4;
+
+			if(!original)
+				continue;
+
+			int period = rotationPeriod(original);
+			int turns = 0;
+
+			for(int rotated = original; rotated != current && turns < 4; turns++)
+				rotated = rotateLeft(rotated);
+
+			if(turns >= period)
+				return false;
+
+			BitModel *pModels = models.turns[shapeClass(original)];
+
+			if(period > 1)
+				encoder.encode(pModels[0], turns & 1);
+
+			if(period > 2)
+				encoder.encode(pModels[1 + (turns & 1)], turns >> 1);
+		}
+	}
+
+	encoder.flush();
+
+	return true;
+}
+
+bool PuzzleCodec::decode(const uint8 *pData, size_t size, BoardState &state)
+{
+	const uint8 *pEnd = pData + size;
+
+	if(pData >= pEnd)
+		return false;
+
+	uint8 flags = *pData++;
+	uint32 width = 0, height = 0, rootX = 0, rootY = 0, relax = 0, seed = 0;
+
+	if(!readVarInt(pData, pEnd, width) || !readVarInt(pData, pEnd, height) ||
+		!readVarInt(pData, pEnd, rootX) || !readVarInt(pData, pEnd, rootY) ||
+		!readVarInt(pData, pEnd, relax) || !readVarInt(pData, pEnd, seed))
+		return false;
+
+	if(width < 3 || height < 3 || width > 0xffff || height > 0xffff || rootX >= width || rootY >= height)
+		return false;
+
+	state.width = int(width);
+	state.height = int(height);
+	state.rootX = int(rootX);
+	state.rootY = int(rootY);
+	state.infiniteMode = (flags & infiniteModeFlag) != 0;
+	state.relax = relax / 1000.;
+	state.seed = seed;
+	state.cells.assign(size_t(width) * size_t(height), 0);
+
+	EdgeModels models;
+	RangeDecoder decoder(pData, pEnd);
+
+	for(int y = 0; y < state.height; y++)
+		for(int x = 0; x < state.width; x++)
+		{
+			uint8 &cell = state.cells[(y * state.width) + x];
+			int context = ((cell & maskLeft) ? 1 : 0) | ((cell & maskTop) ? 2 : 0);
+
+			if(state.infiniteMode || x < state.width - 1)
+			{
+				int upperRight = (y > 0) ? state.cells[((y - 1) * state.width) + ((x + 1) % state.width)] : 0;
+
+				if(decoder.decode(models.right[context | ((upperRight & maskBottom) ? 4 : 0)]))
+				{
+					cell |= maskRight;
+					state.cells[(y * state.width) + ((x + 1) % state.width)] |= maskLeft;
+				}
+			}
+
+			if(state.infiniteMode || y < state.height - 1)
+			{
+				if(decoder.decode(models.bottom[context | ((cell & maskRight) ? 4 : 0)]))
+				{
+					cell |= maskBottom;
+					state.cells[(((y + 1) % state.height) * state.width) + x] |= maskTop;
+				}
+			}
+		}
+
+	for(std::vector<uint8>::iterator it = state.cells.begin(), end = state.cells.end(); it != end; ++it)
+	{
+		int original = *it & 0x0f;
+		int current = original;
+
+		if(original && (flags & shuffleFlag))
+		{
+			int period = rotationPeriod(original);
+			int turns = 0;
+
+			BitModel *pModels = models.turns[shapeClass(original)];
+
+			if(period > 1)
+				turns = decoder.decode(pModels[0]);
+
+			if(period > 2)
+				turns |= decoder.decode(pModels[1 + turns]) << 1;
+
+			while(turns--)
+				current = rotateLeft(current);
+		}
+
+		*it = uint8(original | (current << 4));
+	}
+
+	return !decoder.overrun();
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraStorage.h"
+
+#include <vector>
+
+// Unsigned LEB128: seven bits per byte, the lowest first, the top bit set on every byte but the last.
+inline void writeVarInt(std::vector<uint8> &out, uint32 value)
+{
+	while(value >= 0x80)
+	{
+		out.push_back(uint8(value | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back(uint8(value));
+}
+
+inline bool readVarInt(const uint8 *&pData, const uint8 *pEnd, uint32 &value)
+{
+	value = 0;
+
+	for(int shift = 0; shift < 35 && pData < pEnd; shift += 7)
+	{
+		uint8 byte = *pData++;
+		value |= uint32(byte & 0x7f) << shift;
+
+		if(!(byte & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+// Adaptive binary range coder: 11-bit probabilities that move 1/32 of the way towards every coded bit.
+class BitModel
+{
+public:
+
+	enum
+	{
+		probabilityBits = 11,
+		adaptationShift = 5,
+		one = 1 << probabilityBits
+	};
+
+	uint32 probability;
+
+	BitModel() : probability(one / 2)
+	{
+	}
+};
+
+class RangeEncoder
+{
+private:
+
+	std::vector<uint8> &_out;
+	uint64 _low;
+	uint32 _range;
+	uint8 _cache;
+	uint32 _cacheSize;
+
+	void shiftLow()
+	{
+		if(uint32(_low) < 0xff000000u || uint32(_low >> 32) != 0)
+		{
+			uint8 carry = uint8(_low >> 32);
+			uint8 temp = _cache;
+
+			do
+			{
+				_out.push_back(uint8(temp + carry));
+				temp = 0xff;
+			}
+			while(--_cacheSize != 0);
+
+			_cache = uint8(_low >> 24);
+		}
+
+		_cacheSize++;
+		_low = (_low & 0x00ffffffu) << 8;
+	}
+
+public:
+
+	RangeEncoder(std::vector<uint8> &out) :
+		_out(out),
+		_low(0),
+		_range(0xffffffffu),
+		_cache(0),
+		_cacheSize(1)
+	{
+	}
+
+	void encode(BitModel &model, int bit)
+	{
+		uint32 bound = (_range >> BitModel::probabilityBits) * model.probability;
+
+		if(!bit)
+		{
+			_range = bound;
+			model.probability += (BitModel::one - model.probability) >> BitModel::adaptationShift;
+		}
+		else
+		{
+			_low += bound;
+			_range -= bound;
+			model.probability -= model.probability >> BitModel::adaptationShift;
+		}
+
+		while(_range < (1u << 24))
+		{
+			_range <<= 8;
+			shiftLow();
+		}
+	}
+
+	void flush()
+	{
+		for(int idx = 0; idx < 5; idx++)
+			shiftLow();
+	}
+};
+
+class RangeDecoder
+{
+private:
+
+	const uint8 *_pData;
+	const uint8 *_pEnd;
+	uint32 _code;
+	uint32 _range;
+	bool _overrun;
+
+	uint8 nextByte()
+	{
+		if(_pData < _pEnd)
+			return *_pData++;
+
+		_overrun = true;
+
+		return 0;
+	}
+
+public:
+
+	RangeDecoder(const uint8 *pData, const uint8 *pEnd) :
+		_pData(pData),
+		_pEnd(pEnd),
+		_code(0),
+		_range(0xffffffffu),
+		_overrun(false)
+	{
+		for(int idx = 0; idx < 5; idx++)
+			_code = (_code << 8) | nextByte();
+	}
+
+	int decode(BitModel &model)
+	{
+		uint32 bound = (_range >> BitModel::probabilityBits) * model.probability;
+		int bit = 0;
+
+		if(_code < bound)
+		{
+			_range = bound;
+			model.probability += (BitModel::one - model.probability) >> BitModel::adaptationShift;
+		}
+		else
+		{
+			_code -= bound;
+			_range -= bound;
+			model.probability -= model.probability >> BitModel::adaptationShift;
+			bit = 1;
+		}
+
+		while(_range < (1u << 24))
+		{
+			_range <<= 8;
+			_code = (_code << 8) | nextByte();
+		}
+
+		return bit;
+	}
+
+	bool overrun() const
+	{
+		return _overrun;
+	}
+};
+
+// Compressed puzzle encoding.
+//
+// A generated branch is a tree, so every connection shows up twice, once in each of the two neighbouring nibbles.
+// The codec stores each connection once (the right and the bottom one of every cell, wrapping around on a torus),
+// with the left and top connections of the cell and its upper-right neighbour as the context.
+// Empty (relaxed) cells are the cells without connections, so they need no separate mask.
+// The shuffle is stored as the number of left quarter-turns per non-empty cell, reduced by the symmetry of its shape.
+//
+// Layout: a flags byte (bit 0: infinite mode, bit 1: shuffle present), then width, height, root x, root y,
+// relax value in thousandths and seed as variable-length integers, then the range-coded bits.
+class PuzzleCodec
+{
+public:
+
+	enum
+	{
+		infiniteModeFlag = 1,
+		shuffleFlag = 2
+	};
+
+	// Returns false if the board isn't a valid set of reciprocal connections and can't be stored this way.
+	static bool encode(const BoardState &state, bool withShuffle, std::vector<uint8> &out);
+	static bool decode(const uint8 *pData, size_t size, BoardState &state);
+};
@@ -0,0 +1,338 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraEngine.h"
+
+GameEngine::GameEngine(SakuraBoard &board, Listener *pListener) :
+	Thread(T("game engine")),
+	_board(board),
+	_pListener(pListener),
+	_posted(0),
+	_completed(0),
+	_latestGeneration(0),
+	_generationProgress(-1),
+	_boardUnfinished(false),
+	_backgroundHeld(true),
+	_backgroundRunning(false)
+{
+	_pendingCommands.reserve(maxPendingCommands);
+}
+
+GameEngine::~GameEngine()
+{
+	stopThread(10000);
+	cancelPendingUpdate();
+}
+
+bool GameEngine::post(const EngineCommand &command)
+{
+	if(_pendingCommands.size() >= size_t(maxPendingCommands))
+		return false;
+
+	_pendingCommands.push_back(command);
+
+	// numbered before it's visible to the engine, which would take it for an outdated one otherwise;
+	// a waiting generation is called off by the ones posted after it just the same
+	if(command.commandId == generateCommandId)
+		_pendingCommands.back().generationId = _latestGeneration = _latestGeneration + 1;
+
+	pushPendingCommands();
+	releaseBackground();
+
+	return true;
+}
+
+// In the order they were posted, as far as the queue takes them.
+void GameEngine::pushPendingCommands()
+{
+	size_t pushed = 0;
+
+	while(pushed < _pendingCommands.size() && _commands.push(_pendingCommands[pushed]))
+		pushed++;
+
+	if(!pushed)
+		return;
+
+	_pendingCommands.erase(_pendingCommands.begin(), _pendingCommands.begin() + pushed);
+
+	_posted += uint32(pushed);
+	notify();
+}
+
+void GameEngine::deliverResults()
+{
+	for(EngineResult *pResult = _results.getReadSlot(); pResult; pResult = _results.getReadSlot())
+	{
+		_pListener->engineResult(*pResult);
+		_results.commitRead();
+	}
+}
+
+void GameEngine::waitUntilIdle()
+{
+	_backgroundHeld = true;
+
+	SAKURA_MEMORY_BARRIER();
+
+	while(!isIdle() || _backgroundRunning)
+	{
+		pushPendingCommands();
+		deliverResults();
+		_progress.wait(5);
+	}
+
+	SAKURA_MEMORY_BARRIER();
+
+	deliverResults();
+}
+
+void GameEngine::run()
+{
+	while(!threadShouldExit())
+	{
+		EngineCommand *pCommand = _commands.getReadSlot();
+
+		if(!pCommand)
+		{
+			if(!prepareHintsSlice())
+				wait(-1);
+
+			continue;
+		}
+
+		EngineResult *pResult = _results.getWriteSlot();
+
+		// the message thread is behind with the results; it gets to them on its next update
+		if(!pResult)
+		{
+			triggerAsyncUpdate();
+			wait(1);
+			continue;
+		}
+
+		execute(*pCommand, *pResult);
+
+		_commands.commitRead();
+		_results.commitWrite();
+
+		_completed = _completed + 1;
+		_progress.signal();
+
+		triggerAsyncUpdate();
+	}
+}
+
+void GameEngine::execute(const EngineCommand &command, EngineResult &result)
+{
+	SAKURA_TRACE_SCOPE_ARG("engineCommand", command.commandId);
+
+	result.command = command;
+	result.cellIndex = -1;
+	result.leftTurns = 0;
+	result.retraced = false;
+	result.solved = false;
+	result.cancelled = false;
+	result.rootX = _board.getRootX();
+	result.rootY = _board.getRootY();
+	result.changedCells.clear();
+	result.pSnapshot = _snapshots.getLatest();
+
+	switch(command.commandId)
+	{
+		case generateCommandId:
+			if(!generate(command))
+			{
+				result.cancelled = true;
+				break;
+			}
+
+			_board.clearJournal();
+			_board.clearChangedCells();
+
+			result.pSnapshot = _snapshots.publish(_board);
+			break;
+
+		case shuffleCommandId:
+			if(_boardUnfinished)
+				break;
+
+			_board.shuffle(command.seed);
+			_board.clearChangedCells();
+
+			result.pSnapshot = _snapshots.publish(_board);
+			break;
+
+		// a solved board takes no more moves, as the matrix doesn't let them through either
+		case rotateLeftCommandId:
+			if(command.cellIndex < 0 || command.cellIndex >= _board.getNumCells() || _boardUnfinished || _board.isSolved())
+				break;
+
+			result.leftTurns = (command.leftTurns ? command.leftTurns : _board.getCell(command.cellIndex).getLeftTurnsToPlace()) & 3;
+
+			if(!result.leftTurns)
+				break;
+
+			result.cellIndex = command.cellIndex;
+			result.retraced = _board.rotateCell(command.cellIndex, result.leftTurns);
+
+			_hints.cellTurned(_board, result.cellIndex);
+
+			publishMove(result);
+			break;
+
+		// turns the forced cell into its place, as a move of its own
+		case hintCommandId:
+			if(_boardUnfinished || _board.isSolved())
+				break;
+
+			// a loaded board's hints may still be on the way
+			if(!_hints.isPrepared(_board))
+			{
+				result.cancelled = true;
+				break;
+			}
+
+			result.cellIndex = _hints.getForcedCell(_board);
+
+			if(result.cellIndex < 0)
+				break;
+
+			result.leftTurns = _board.getCell(result.cellIndex).getLeftTurnsToPlace();
+			result.retraced = _board.rotateCell(result.cellIndex, result.leftTurns);
+
+			_hints.cellTurned(_board, result.cellIndex);
+
+			publishMove(result);
+			break;
+
+		case undoCommandId:
+		case redoCommandId:
+			if(_boardUnfinished || _board.isSolved())
+				break;
+
+			result.cellIndex = (command.commandId == undoCommandId) ? _board.undoMove(result.retraced) : _board.redoMove(result.retraced);
+
+			if(result.cellIndex >= 0)
+			{
+				_hints.cellTurned(_board, result.cellIndex);
+
+				publishMove(result);
+			}
+			break;
+	}
+
+	result.boardMemory = _board.getMemoryUsage() + _snapshots.getMemoryUsage() + _hints.getMemoryUsage();
+}
+
+// Returns false if the generation was called off, before it began or between two of its slices.
+bool GameEngine::generate(const EngineCommand &command)
+{
+	if(command.generationId != _latestGeneration)
+		return false;
+
+	// the whole generation, all of its slices and the hints
+	SAKURA_PROFILE_SCOPE(generate);
+
+	_board.beginBranch(command.infiniteMode, command.relax, command.seed);
+	_boardUnfinished = true;
+
+	while(_board.continueBranch(generationSliceSteps))
+	{
+		_generationProgress = int(_board.getGenerationProgress() * 1000.);
+
+		if(command.generationId != _latestGeneration || threadShouldExit())
+		{
+			_board.cancelBranch();
+			_generationProgress = -1;
+
+			return false;
+		}
+	}
+
+	// the hint domains of a big board take about as long again, so they are sliced the same way
+	_hints.beginPrepare(_board);
+
+	while(_hints.continuePrepare(_board, generationSliceSteps))
+	{
+		if(command.generationId != _latestGeneration || threadShouldExit())
+		{
+			_generationProgress = -1;
+
+			return false;
+		}
+	}
+
+	_generationProgress = -1;
+	_boardUnfinished = false;
+
+	return true;
+}
+
+// Returns true if there was a slice to do; the board is only read, and only while the message thread keeps off it.
+bool GameEngine::prepareHintsSlice()
+{
+	_backgroundRunning = true;
+
+	SAKURA_MEMORY_BARRIER();
+
+	bool working = !_backgroundHeld && !_boardUnfinished && !_hints.isPrepared(_board);
+
+	if(working)
+	{
+		if(!_hints.isPreparing(_board))
+			_hints.beginPrepare(_board);
+
+		_hints.continuePrepare(_board, generationSliceSteps);
+	}
+
+	SAKURA_MEMORY_BARRIER();
+
+	_backgroundRunning = false;
+
+	return working;
+}
+
+// A move only copies the tiles of the cells it changed; a traced path or a solved board is compared tile by tile.
+void GameEngine::publishMove(EngineResult &result)
+{
+	{
+		SAKURA_PROFILE_SCOPE(solvedCheck);
+
+		result.solved = _board.isSolved();
+	}
+
+	if(result.solved)
+		_board.setAllCellsLive(SakuraBoard::Solved);
+
+	if(result.solved || result.retraced)
+		result.pSnapshot = _snapshots.publish(_board);
+	else
+	{
+		// the result slot keeps its capacity from the moves before
+		result.changedCells.assign(_board.getChangedCells().begin(), _board.getChangedCells().end());
+
+		_publishedCells.assign(1, result.cellIndex);
+		_publishedCells.insert(_publishedCells.end(), result.changedCells.begin(), result.changedCells.end());
+
+		result.pSnapshot = _snapshots.publish(_board, _publishedCells);
+	}
+
+	_board.clearChangedCells();
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraBoard.h"
+#include "SakuraHint.h"
+#include "SakuraQueue.h"
+#include "SakuraSnapshot.h"
+
+#include <vector>
+
+// The matrix's command ids, also the ids of the moves its game engine runs.
+enum TimerCommands
+{
+	generateCommandId = 1000,
+	shuffleCommandId,
+	peekCommandId,
+	hintCommandId,
+	settingsCommandId,
+	overlayCommandId,
+	keyboardMoveLeftCommandId,
+	keyboardMoveUpCommandId,
+	keyboardMoveRightCommandId,
+	keyboardMoveDownCommandId,
+	rotateLeftCommandId,
+	rotateRightCommandId,
+	undoCommandId,
+	redoCommandId,
+	zoomInCommandId,
+	zoomOutCommandId,
+
+	// timers only, not commands
+	loadOrnamentsTimerId,
+	overlayTimerId,
+	animationTimerId,
+	generationTimerId
+};
+
+struct EngineCommand
+{
+	int commandId;
+	int cellIndex;
+
+	// left quarter-turns of a rotation; 0 turns the cell into its place
+	int leftTurns;
+
+	bool infiniteMode;
+	double relax;
+	uint32 seed;
+
+	// numbered by post(); a generation is called off once a later one is posted
+	uint32 generationId;
+
+	// when the input behind a move arrived, 0 for the rest; it comes back with the result
+	int64 inputTicks;
+
+	EngineCommand(int id = 0, int cell = -1, int turns = 0) :
+		commandId(id),
+		cellIndex(cell),
+		leftTurns(turns),
+		infiniteMode(false),
+		relax(0.),
+		seed(0),
+		generationId(0),
+		inputTicks(0)
+	{
+	}
+};
+
+// What a command did to the board, for the message thread to show and to record.
+struct EngineResult
+{
+	EngineCommand command;
+
+	// the turned cell; -1 if the move did nothing
+	int cellIndex;
+	int leftTurns;
+	bool retraced;
+	bool solved;
+
+	// a generation called off halfway, the board hasn't changed as far as the snapshot goes;
+	// or a hint asked for while the hints are still being prepared
+	bool cancelled;
+
+	// the root a generated branch grew from
+	int rootX;
+	int rootY;
+
+	size_t boardMemory;
+
+	// the cells whose live state a move changed, unless the path was traced again
+	std::vector<int> changedCells;
+
+	// the board after the command
+	const BoardSnapshot *pSnapshot;
+};
+
+// Runs the moves on a thread of its own, so a slow generation or liveness trace never holds up painting and input.
+// The message thread posts commands through one lock-free queue and gets the results back through another;
+// they are handed to the listener on the message thread, each with the snapshot of the board it left.
+// The board belongs to the engine thread, the message thread may only use it directly after waitUntilIdle()
+// and before its next post().
+// A branch is generated in slices of steps, so a newer generation or cancelGeneration() stops a big one
+// within a slice rather than after the whole board.
+class GameEngine : public Thread, private AsyncUpdater
+{
+public:
+
+	class Listener
+	{
+	public:
+
+		virtual ~Listener()
+		{
+		}
+
+		virtual void engineResult(EngineResult &result) = 0;
+	};
+
+	enum
+	{
+		queueSize = 256,
+		maxPendingCommands = queueSize,
+		generationSliceSteps = 1 << 16
+	};
+
+private:
+
+	SakuraBoard &_board;
+	Listener *_pListener;
+
+	SpscQueue<EngineCommand, queueSize> _commands;
+	SpscQueue<EngineResult, queueSize> _results;
+
+	// posted while the queue was full, they go in as the engine catches up; message thread only
+	std::vector<EngineCommand> _pendingCommands;
+
+	SnapshotPublisher _snapshots;
+	std::vector<int> _publishedCells;
+
+	HintSolver _hints;
+
+	// counted by the message thread and by the engine thread
+	uint32 _posted;
+	volatile uint32 _completed;
+	WaitableEvent _progress;
+
+	// the last generation posted, or called off, by the message thread
+	volatile uint32 _latestGeneration;
+
+	// in tenths of a percent, -1 while there's no generation running
+	volatile int _generationProgress;
+
+	// a cancelled generation left the board half-made, so the moves wait for the next branch
+	bool _boardUnfinished;
+
+	// The hints of a board changed directly are prepared in slices while the engine has nothing else to do.
+	// waitUntilIdle() holds the slices back and waits for the one running, as the message thread is about
+	// to use the board; they are let go again by the next post() or update.
+	volatile bool _backgroundHeld;
+	volatile bool _backgroundRunning;
+
+	void execute(const EngineCommand &command, EngineResult &result);
+	bool generate(const EngineCommand &command);
+	bool prepareHintsSlice();
+	void publishMove(EngineResult &result);
+	void pushPendingCommands();
+
+	void releaseBackground()
+	{
+		_backgroundHeld = false;
+		notify();
+	}
+
+	// the message thread isn't in the middle of anything it did to the board here
+	void handleAsyncUpdate()
+	{
+		pushPendingCommands();
+		deliverResults();
+		releaseBackground();
+	}
+
+	GameEngine(const GameEngine &);
+	GameEngine &operator = (const GameEngine &);
+
+public:
+
+	GameEngine(SakuraBoard &board, Listener *pListener);
+	~GameEngine();
+
+	// A command posted while the engine is a whole queue behind waits for the next update.
+	// Returns false, dropping the command, only once maxPendingCommands are waiting as well.
+	bool post(const EngineCommand &command);
+
+	// Calls off the generation running and those posted so far; they come back cancelled.
+	void cancelGeneration()
+	{
+		_latestGeneration = _latestGeneration + 1;
+	}
+
+	int getGenerationProgress() const
+	{
+		return _generationProgress;
+	}
+
+	// Hands the results that are ready to the listener.
+	void deliverResults();
+
+	// Waits for every posted command, delivering the results on the way.
+	void waitUntilIdle();
+
+	bool isIdle() const
+	{
+		return _completed == _posted && _pendingCommands.empty();
+	}
+
+	// After the board was changed directly, while the engine is idle; its hints get prepared after the update.
+	const BoardSnapshot *publishBoard()
+	{
+		_boardUnfinished = false;
+
+		triggerAsyncUpdate();
+
+		return _snapshots.publish(_board);
+	}
+
+	// The message thread shows the given snapshot now; the older ones can go.
+	void releaseSnapshotsBefore(const BoardSnapshot *pSnapshot)
+	{
+		_snapshots.setReaderVersion(pSnapshot->getVersion());
+	}
+
+	// Bytes held by the snapshots, the shown one and those waiting to be freed; engine thread or idle only.
+	size_t getSnapshotMemory() const
+	{
+		return _snapshots.getMemoryUsage();
+	}
+
+	void run();
+};
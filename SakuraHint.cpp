@@ -0,0 +1,266 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraHint.h"
+
+namespace
+{
+	int rotateMaskLeft(int mask)
+	{
+		return ((mask >> 1) | ((mask & 1) << 3)) & 0x0f;
+	}
+
+	// the number of different orientations of a mask
+	int rotationPeriod(int mask)
+	{
+		int rotated = rotateMaskLeft(mask);
+
+		if(rotated == mask)
+			return 1;
+
+		return (rotateMaskLeft(rotated) == mask) ? 2 : 4;
+	}
+
+	// what a side of a cell allows: bit 0 no connection, bit 1 a connection
+	enum
+	{
+		allowsNone = 1,
+		allowsConnection = 2
+	};
+
+	// The sides an original mask allows with a domain of turns, two bits a direction.
+	class SidesTable
+	{
+	private:
+
+		uint8 _sides[16][16];
+
+	public:
+
+		SidesTable()
+		{
+			for(int original = 0; original < 16; original++)
+				for(int domain = 0; domain < 16; domain++)
+				{
+					int sides = 0;
+
+					for(int turns = 0, mask = original; turns < 4; turns++, mask = rotateMaskLeft(mask))
+						if(domain & (1 << turns))
+							for(int direction = 0; direction < 4; direction++)
+								sides |= (((mask >> direction) & 1) ? allowsConnection : allowsNone) << (direction * 2);
+
+					_sides[original][domain] = uint8(sides);
+				}
+		}
+
+		int getSides(int original, int domain, int direction) const
+		{
+			return (_sides[original][domain] >> (direction * 2)) & 3;
+		}
+	};
+
+	const SidesTable __sidesTable;
+}
+
+HintSolver::HintSolver() :
+	_scannedCells(0),
+	_puzzleHash(0),
+	_prepared(false)
+{
+}
+
+void HintSolver::beginPrepare(const SakuraBoard &board)
+{
+	const std::vector<Cell> &cells = board.getCells();
+
+	_domains.resize(cells.size());
+	_pendingCells.clear();
+	_forcedCells.clear();
+
+	for(int cellIndex = 0, count = int(cells.size()); cellIndex < count; cellIndex++)
+		_domains[cellIndex] = uint8((1 << rotationPeriod(cells[cellIndex].getMask(true))) - 1);
+
+	_scannedCells = 0;
+	_puzzleHash = board.getPuzzleHash();
+	_prepared = false;
+}
+
+bool HintSolver::continuePrepare(const SakuraBoard &board, int maxSteps)
+{
+	SAKURA_TRACE_SCOPE("prepareHints");
+
+	const std::vector<Cell> &cells = board.getCells();
+	int width = board.getWidth();
+	int height = board.getHeight();
+
+	// only the edges and the empty cells constrain anything to begin with; their consequences go first,
+	// so the pending cells stay few
+	for(int count = int(cells.size()); _scannedCells < count && maxSteps > 0; _scannedCells++, maxSteps--)
+	{
+		int x = _scannedCells % width;
+		int y = _scannedCells / width;
+
+		if(!cells[_scannedCells].notEmpty())
+			addNeighbours(board, _scannedCells);
+		else
+			if(!board.isInfiniteMode() && (!x || !y || x == width - 1 || y == height - 1))
+				addPending(_scannedCells);
+
+		maxSteps = propagate(board, maxSteps);
+	}
+
+	maxSteps = propagate(board, maxSteps);
+
+	if(_scannedCells < int(cells.size()) || !_pendingCells.empty())
+		return true;
+
+	_prepared = true;
+
+	return false;
+}
+
+void HintSolver::cellTurned(const SakuraBoard &board, int cellIndex)
+{
+	if(!isPrepared(board) || cellIndex < 0 || cellIndex >= int(_domains.size()))
+		return;
+
+	// turned out of its place, a forced cell is worth a hint again
+	if((_domains[cellIndex] & domainMask) == 1 && !board.getCells()[cellIndex].isInPlace())
+		addForced(cellIndex);
+}
+
+int HintSolver::getForcedCell(const SakuraBoard &board)
+{
+	const std::vector<Cell> &cells = board.getCells();
+
+	while(!_forcedCells.empty())
+	{
+		int cellIndex = _forcedCells.back();
+
+		if(!cells[cellIndex].isInPlace())
+			return cellIndex;
+
+		_forcedCells.pop_back();
+		_domains[cellIndex] &= ~forcedFlag;
+	}
+
+	return -1;
+}
+
+// The sides the cell's domain still allows towards the given direction.
+int HintSolver::getSides(const std::vector<Cell> &cells, int cellIndex, int direction) const
+{
+	return __sidesTable.getSides(cells[cellIndex].getMask(true), _domains[cellIndex] & domainMask, direction);
+}
+
+// Drops the orientations no neighbour agrees with; returns true if any were dropped.
+bool HintSolver::revise(const SakuraBoard &board, int cellIndex)
+{
+	const std::vector<Cell> &cells = board.getCells();
+	int domain = _domains[cellIndex] & domainMask;
+	int x = cellIndex % board.getWidth();
+	int y = cellIndex / board.getWidth();
+	int r_x = 0;
+	int r_y = 0;
+	int allowed[4];
+
+	for(int direction = 0; direction < 4; direction++)
+		allowed[direction] = board.getNeighbour(x, y, direction, r_x, r_y) ?
+			getSides(cells, (r_y * board.getWidth()) + r_x, (direction + 2) % 4) : int(allowsNone);
+
+	int revised = 0;
+
+	for(int turns = 0, mask = cells[cellIndex].getMask(true); turns < 4; turns++, mask = rotateMaskLeft(mask))
+	{
+		if(!(domain & (1 << turns)))
+			continue;
+
+		bool fits = true;
+
+		for(int direction = 0; direction < 4 && fits; direction++)
+			fits = (allowed[direction] & (((mask >> direction) & 1) ? allowsConnection : allowsNone)) != 0;
+
+		if(fits)
+			revised |= 1 << turns;
+	}
+
+	// the original orientation always fits, whatever else goes
+	jassert(revised & 1);
+
+	if(revised == domain)
+		return false;
+
+	_domains[cellIndex] = uint8((_domains[cellIndex] & ~domainMask) | revised);
+
+	if(revised == 1)
+		addForced(cellIndex);
+
+	return true;
+}
+
+void HintSolver::addPending(int cellIndex)
+{
+	uint8 &domain = _domains[cellIndex];
+
+	// a single orientation can't get any narrower
+	if((domain & pendingFlag) || (domain & domainMask) == 1)
+		return;
+
+	domain |= pendingFlag;
+	_pendingCells.push_back(cellIndex);
+}
+
+void HintSolver::addForced(int cellIndex)
+{
+	if(_domains[cellIndex] & forcedFlag)
+		return;
+
+	_domains[cellIndex] |= forcedFlag;
+	_forcedCells.push_back(cellIndex);
+}
+
+void HintSolver::addNeighbours(const SakuraBoard &board, int cellIndex)
+{
+	int x = cellIndex % board.getWidth();
+	int y = cellIndex / board.getWidth();
+	int r_x = 0;
+	int r_y = 0;
+
+	for(int direction = 0; direction < 4; direction++)
+		if(board.getNeighbour(x, y, direction, r_x, r_y))
+			addPending((r_y * board.getWidth()) + r_x);
+}
+
+// Returns the steps left.
+int HintSolver::propagate(const SakuraBoard &board, int maxSteps)
+{
+	for(; !_pendingCells.empty() && maxSteps > 0; maxSteps--)
+	{
+		int cellIndex = _pendingCells.back();
+		_pendingCells.pop_back();
+
+		_domains[cellIndex] &= ~pendingFlag;
+
+		if(revise(board, cellIndex))
+			addNeighbours(board, cellIndex);
+	}
+
+	return maxSteps;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraBoard.h"
+
+#include <vector>
+
+// Rotation domains of the cells, for the hints: the orientations a cell may still take, as far as the board's edges,
+// the empty cells and the neighbours' domains go. Only what the player can see narrows them, never the solution,
+// so they are worked out once per puzzle, by propagation from the edges and the empty cells. A cell whose domain
+// is down to one orientation is forced, and the hint shows the last one found that isn't in its place; a move
+// only has to put a forced cell turned out of its place back on the list.
+class HintSolver
+{
+private:
+
+	enum
+	{
+		domainMask = 0x0f,
+		forcedFlag = 0x40,
+		pendingFlag = 0x80
+	};
+
+	// per cell: bit N for the original mask turned left N times, whether it's on the forced list
+	// and whether it waits to be revised
+	std::vector<uint8> _domains;
+	std::vector<int> _pendingCells;
+	std::vector<int> _forcedCells;
+
+	// the cells scanned for the first constraints while preparing
+	int _scannedCells;
+
+	uint64 _puzzleHash;
+	bool _prepared;
+
+	int getSides(const std::vector<Cell> &cells, int cellIndex, int direction) const;
+	bool revise(const SakuraBoard &board, int cellIndex);
+	void addPending(int cellIndex);
+	void addForced(int cellIndex);
+	void addNeighbours(const SakuraBoard &board, int cellIndex);
+	int propagate(const SakuraBoard &board, int maxSteps);
+
+public:
+
+	HintSolver();
+
+	// Starts the domains over from the puzzle's own constraints; continuePrepare() then does at most
+	// the given number of cells and returns true while there's more to do.
+	void beginPrepare(const SakuraBoard &board);
+	bool continuePrepare(const SakuraBoard &board, int maxSteps);
+
+	// Whether the domains are this puzzle's, all worked out or on the way.
+	bool isPreparing(const SakuraBoard &board) const
+	{
+		return _puzzleHash == board.getPuzzleHash() && int(_domains.size()) == board.getNumCells();
+	}
+
+	bool isPrepared(const SakuraBoard &board) const
+	{
+		return _prepared && isPreparing(board);
+	}
+
+	// After the cell was turned by a move; O(1).
+	void cellTurned(const SakuraBoard &board, int cellIndex);
+
+	// A forced cell out of its place, or -1 if there's none.
+	int getForcedCell(const SakuraBoard &board);
+
+	size_t getMemoryUsage() const
+	{
+		return (_domains.capacity() * sizeof(uint8)) + ((_pendingCells.capacity() + _forcedCells.capacity()) * sizeof(int));
+	}
+};
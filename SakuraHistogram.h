@@ -0,0 +1,154 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+
+// Histogram of latencies with a bounded relative error: every power of two is split into 16 buckets,
+// so a percentile is off by at most 1/16 of its value, whatever the range of the samples.
+class LatencyHistogram
+{
+private:
+
+	enum
+	{
+		subBuckets = 16,
+		numBuckets = 61 * subBuckets
+	};
+
+	uint32 _counts[numBuckets];
+	uint64 _count;
+	uint64 _total;
+	uint64 _max;
+
+	static int getHighestBit(uint64 value)
+	{
+		int bit = 0;
+
+		for(int shift = 32; shift; shift >>= 1)
+			if(value >> (bit + shift))
+				bit += shift;
+
+		return bit;
+	}
+
+	static int getBucket(uint64 value)
+	{
+		if(value < subBuckets)
+			return int(value);
+
+		int bit = getHighestBit(value);
+
+		return ((bit - 3) * subBuckets) + int((value >> (bit - 4)) & (subBuckets - 1));
+	}
+
+	// The largest value that falls into the bucket.
+	static uint64 getBucketLimit(int bucket)
+	{
+		if(bucket < subBuckets)
+			return uint64(bucket);
+
+		int shift = (bucket / subBuckets) - 1;
+		uint64 lower = uint64(subBuckets + (bucket % subBuckets)) << shift;
+
+		return lower + (uint64(1) << shift) - 1;
+	}
+
+public:
+
+	LatencyHistogram()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		zeromem(_counts, sizeof(_counts));
+
+		_count = 0;
+		_total = 0;
+		_max = 0;
+	}
+
+	void record(uint64 value)
+	{
+		_counts[getBucket(value)]++;
+		_count++;
+		_total += value;
+
+		if(value > _max)
+			_max = value;
+	}
+
+	void merge(const LatencyHistogram &other)
+	{
+		for(int bucket = 0; bucket < numBuckets; bucket++)
+			_counts[bucket] += other._counts[bucket];
+
+		_count += other._count;
+		_total += other._total;
+		if(other._max > _max)
+			_max = other._max;
+	}
+
+	uint64 getCount() const
+	{
+		return _count;
+	}
+
+	uint64 getMax() const
+	{
+		return _max;
+	}
+
+	double getMean() const
+	{
+		return _count ? double(_total) / double(_count) : .0;
+	}
+
+	// fraction is 0..1, e.g. .99 for the 99th percentile
+	uint64 getPercentile(double fraction) const
+	{
+		if(!_count)
+			return 0;
+
+		uint64 rank = uint64(fraction * double(_count) + .5);
+
+		if(rank < 1)
+			rank = 1;
+
+		uint64 seen = 0;
+
+		for(int bucket = 0; bucket < numBuckets; bucket++)
+		{
+			seen += _counts[bucket];
+
+			if(seen >= rank)
+			{
+				uint64 limit = getBucketLimit(bucket);
+
+				return (limit < _max) ? limit : _max;
+			}
+		}
+
+		return _max;
+	}
+};
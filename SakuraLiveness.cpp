@@ -0,0 +1,203 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraLiveness.h"
+#include "SakuraTrace.h"
+
+TiledLiveness::TiledLiveness() :
+	_pPool(0),
+	_numThreads(jmax(1, SystemStats::getNumCpus())),
+	_pPlanes(0),
+	_pLive(0),
+	_infiniteMode(false),
+	_rootRepresentative(-1),
+	_phase(labelPhase)
+{
+}
+
+TiledLiveness::~TiledLiveness()
+{
+	deleteAndZero(_pPool);
+
+	for(std::vector<TileJob*>::iterator it = _jobs.begin(), end = _jobs.end(); it != end; ++it)
+		delete *it;
+}
+
+// A couple of bands per thread evens out the bands that happen to hold more of the branch.
+void TiledLiveness::splitIntoTiles(int width, int height)
+{
+	int numTiles = jmin(_numThreads * 2, jmax(1, (width * height) / minimalCellsPerTile), height);
+
+	if(getNumTiles() == numTiles && _tileRows.back() == height)
+		return;
+
+	_tileRows.resize(numTiles + 1);
+
+	for(int tile = 0; tile <= numTiles; tile++)
+		_tileRows[tile] = int((int64(height) * tile) / numTiles);
+
+	while(int(_jobs.size()) < numTiles)
+		_jobs.push_back(new TileJob(*this, int(_jobs.size())));
+}
+
+void TiledLiveness::runTile(int tile)
+{
+	if(_phase == labelPhase)
+		labelTile(tile);
+	else
+		markTile(tile);
+}
+
+void TiledLiveness::runPhase(Phase phase)
+{
+	_phase = phase;
+
+	int numTiles = getNumTiles();
+
+	if(numTiles == 1)
+	{
+		runTile(0);
+		return;
+	}
+
+	if(!_pPool)
+		_pPool = new ThreadPool(_numThreads);
+
+	for(int tile = 0; tile < numTiles; tile++)
+		_pPool->addJob(_jobs[tile]);
+
+	for(int tile = 0; tile < numTiles; tile++)
+		_pPool->waitForJobToFinish(_jobs[tile], -1);
+}
+
+void TiledLiveness::labelTile(int tile)
+{
+	SAKURA_TRACE_SCOPE_ARG("labelTile", tile);
+
+	int firstRow = _tileRows[tile];
+	int endRow = _tileRows[tile + 1];
+	int width = _pPlanes->getWidth();
+	int wordsPerRow = _pPlanes->getWordsPerRow();
+
+	_pPlanes->computeConnections(_infiniteMode, firstRow, endRow);
+
+	for(int index = firstRow * width, end = endRow * width; index < end; index++)
+		_parents[index] = index;
+
+	for(int y = firstRow; y < endRow; y++)
+	{
+		const uint64 *pEast = _pPlanes->getEastRow(y);
+		const uint64 *pSouth = _pPlanes->getSouthRow(y);
+		int rowStart = y * width;
+
+		for(int word = 0; word < wordsPerRow; word++)
+		{
+			for(uint64 bits = pEast[word]; bits; bits &= bits - 1)
+			{
+				int x = (word * 64) + BoardBitplanes::getLowestBit(bits);
+
+				unite(rowStart + x, (x + 1 < width) ? rowStart + x + 1 : rowStart);
+			}
+
+			// the connections down from the last row are left to the stitching
+			if(y + 1 < endRow)
+				for(uint64 bits = pSouth[word]; bits; bits &= bits - 1)
+				{
+					int index = rowStart + (word * 64) + BoardBitplanes::getLowestBit(bits);
+
+					unite(index, index + width);
+				}
+		}
+	}
+
+	for(int index = firstRow * width, end = endRow * width; index < end; index++)
+		_parents[index] = find(index);
+}
+
+void TiledLiveness::markTile(int tile)
+{
+	SAKURA_TRACE_SCOPE_ARG("markTile", tile);
+
+	int width = _pPlanes->getWidth();
+	int wordsPerRow = _pPlanes->getWordsPerRow();
+	std::vector<uint64> &live = *_pLive;
+
+	for(int y = _tileRows[tile]; y < _tileRows[tile + 1]; y++)
+		for(int word = 0, x = 0; word < wordsPerRow; word++)
+		{
+			uint64 bits = 0;
+
+			for(int bit = 0; bit < 64 && x < width; bit++, x++)
+				if(findConst((y * width) + x) == _rootRepresentative)
+					bits |= uint64(1) << bit;
+
+			live[(y * wordsPerRow) + word] = bits;
+		}
+}
+
+void TiledLiveness::compute(BoardBitplanes &planes, int rootX, int rootY, bool infiniteMode, std::vector<uint64> &live)
+{
+	int width = planes.getWidth();
+	int height = planes.getHeight();
+
+	_pPlanes = &planes;
+	_pLive = &live;
+	_infiniteMode = infiniteMode;
+
+	_parents.resize(width * height);
+	live.assign(planes.getWordsPerRow() * height, uint64(0));
+
+	splitIntoTiles(width, height);
+	runPhase(labelPhase);
+
+	for(int tile = 0, numTiles = getNumTiles(); tile < numTiles; tile++)
+	{
+		int lastRow = _tileRows[tile + 1] - 1;
+
+		if(lastRow + 1 == height && !infiniteMode)
+			continue;
+
+		const uint64 *pSouth = planes.getSouthRow(lastRow);
+		int below = ((lastRow + 1) % height) * width;
+
+		for(int word = 0; word < planes.getWordsPerRow(); word++)
+			for(uint64 bits = pSouth[word]; bits; bits &= bits - 1)
+			{
+				int x = (word * 64) + BoardBitplanes::getLowestBit(bits);
+
+				unite((lastRow * width) + x, below + x);
+			}
+	}
+
+	// the root alone isn't a branch
+	int leftX = rootX ? rootX - 1 : width - 1;
+	int aboveY = rootY ? rootY - 1 : height - 1;
+	bool connected = ((planes.getEastRow(rootY)[rootX >> 6] >> (rootX & 63)) & 1) ||
+		((planes.getSouthRow(rootY)[rootX >> 6] >> (rootX & 63)) & 1) ||
+		((planes.getEastRow(rootY)[leftX >> 6] >> (leftX & 63)) & 1) ||
+		((planes.getSouthRow(aboveY)[rootX >> 6] >> (rootX & 63)) & 1);
+
+	if(!connected)
+		return;
+
+	_rootRepresentative = find((rootY * width) + rootX);
+
+	runPhase(markPhase);
+}
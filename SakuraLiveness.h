@@ -0,0 +1,145 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+#include "SakuraBitplanes.h"
+
+#include <vector>
+
+// Full-board liveness on a pool of threads, for the boards of millions of cells.
+// The board is cut into bands of rows. Every band labels its own connected pieces with a union-find
+// over the cell indices; one pass then joins the pieces across the band borders, the torus wrap included,
+// and a last parallel pass marks the cells of the root's piece. Like the flood fill, an isolated root stays dead.
+class TiledLiveness
+{
+public:
+
+	enum
+	{
+		minimalCellsPerTile = 64 * 1024
+	};
+
+private:
+
+	enum Phase
+	{
+		labelPhase,
+		markPhase
+	};
+
+	class TileJob : public ThreadPoolJob
+	{
+	private:
+
+		TiledLiveness &_owner;
+		int _tile;
+
+	public:
+
+		TileJob(TiledLiveness &owner, int tile) :
+			ThreadPoolJob(T("liveness tile")),
+			_owner(owner),
+			_tile(tile)
+		{
+		}
+
+		JobStatus runJob()
+		{
+			_owner.runTile(_tile);
+
+			return jobHasFinished;
+		}
+	};
+
+	ThreadPool *_pPool;
+	int _numThreads;
+	std::vector<TileJob*> _jobs;
+
+	// the first row of every tile, followed by the height of the board
+	std::vector<int> _tileRows;
+	std::vector<int> _parents;
+
+	BoardBitplanes *_pPlanes;
+	std::vector<uint64> *_pLive;
+	bool _infiniteMode;
+	int _rootRepresentative;
+	Phase _phase;
+
+	TiledLiveness(const TiledLiveness &);
+	TiledLiveness &operator = (const TiledLiveness &);
+
+	// Path halving; only ever called on the indices one thread owns.
+	int find(int index)
+	{
+		while(_parents[index] != index)
+		{
+			_parents[index] = _parents[_parents[index]];
+			index = _parents[index];
+		}
+
+		return index;
+	}
+
+	int findConst(int index) const
+	{
+		while(_parents[index] != index)
+			index = _parents[index];
+
+		return index;
+	}
+
+	// The smaller index always wins, so the labels don't depend on the order of the unions.
+	void unite(int first, int second)
+	{
+		first = find(first);
+		second = find(second);
+
+		if(first < second)
+			_parents[second] = first;
+		else if(second < first)
+			_parents[first] = second;
+	}
+
+	void runTile(int tile);
+	void labelTile(int tile);
+	void markTile(int tile);
+	void runPhase(Phase phase);
+	void splitIntoTiles(int width, int height);
+
+public:
+
+	TiledLiveness();
+	~TiledLiveness();
+
+	int getNumTiles() const
+	{
+		return int(_tileRows.size()) - 1;
+	}
+
+	size_t getMemoryUsage() const
+	{
+		return (_parents.capacity() + _tileRows.capacity()) * sizeof(int);
+	}
+
+	// Fills live with the cells connected to the root, laid out like a plane.
+	void compute(BoardBitplanes &planes, int rootX, int rootY, bool infiniteMode, std::vector<uint64> &live);
+};
@@ -0,0 +1,61 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraMemory.h"
+
+#include <cstdlib>
+
+#ifdef SAKURA_COUNT_ALLOCATIONS
+// the replacements have to match <new>, whose exception specifications went away with C++11
+#if __cplusplus >= 201103L
+#define SAKURA_THROWS_BAD_ALLOC
+#define SAKURA_THROWS_NOTHING noexcept
+#else
+#define SAKURA_THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define SAKURA_THROWS_NOTHING throw()
+#endif
+
+void *operator new(size_t size) SAKURA_THROWS_BAD_ALLOC
+{
+	AllocationCounter::increment();
+
+	void *p = std::malloc(size ? size : 1);
+
+	if(!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void *operator new[](size_t size) SAKURA_THROWS_BAD_ALLOC
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) SAKURA_THROWS_NOTHING
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) SAKURA_THROWS_NOTHING
+{
+	std::free(p);
+}
+#endif
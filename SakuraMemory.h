@@ -0,0 +1,254 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+
+// Counts calls to the global operator new.
+// The counting operators are compiled in only when SAKURA_COUNT_ALLOCATIONS is defined (see SakuraMemory.cpp),
+// otherwise the counter just stays at zero.
+class AllocationCounter
+{
+private:
+
+	static int &counter()
+	{
+		static int __count = 0;
+
+		return __count;
+	}
+
+public:
+
+	static void increment()
+	{
+		atomicIncrement(counter());
+	}
+
+	static int get()
+	{
+		return counter();
+	}
+
+	// Remembers the counter at construction, so the allocations made by a piece of code can be asserted on.
+	class Scope
+	{
+	private:
+
+		int _start;
+
+	public:
+
+		Scope() : _start(AllocationCounter::get())
+		{
+		}
+
+		int getAllocations() const
+		{
+			return AllocationCounter::get() - _start;
+		}
+	};
+};
+
+// Bump allocator for the objects that live as long as one generated board.
+// Nothing is freed individually: release() drops everything at once and merges the chunks into one of their total size,
+// so generating the next board of the same size doesn't allocate at all.
+class BoardArena
+{
+private:
+
+	enum
+	{
+		alignment = 16,
+		minimalChunkSize = 64 * 1024
+	};
+
+	struct Chunk
+	{
+		char *pData;
+		size_t size;
+	};
+
+	std::vector<Chunk> _chunks;
+	char *_pCurrent;
+	size_t _available;
+	size_t _allocated;
+
+	void addChunk(size_t size)
+	{
+		Chunk chunk;
+		chunk.size = std::max(size, _chunks.empty() ? size_t(minimalChunkSize) : _chunks.back().size * 2);
+		chunk.pData = static_cast<char*>(::operator new(chunk.size));
+
+		_chunks.push_back(chunk);
+
+		_pCurrent = chunk.pData;
+		_available = chunk.size;
+	}
+
+public:
+
+	BoardArena() :
+		_pCurrent(0),
+		_available(0),
+		_allocated(0)
+	{
+	}
+
+	~BoardArena()
+	{
+		for(std::vector<Chunk>::iterator it = _chunks.begin(), end = _chunks.end(); it != end; ++it)
+			::operator delete((*it).pData);
+	}
+
+	void *allocate(size_t size)
+	{
+		size = (size + alignment - 1) & ~size_t(alignment - 1);
+
+		if(size > _available)
+			addChunk(size);
+
+		void *p = _pCurrent;
+
+		_pCurrent += size;
+		_available -= size;
+		_allocated += size;
+
+		return p;
+	}
+
+	void release()
+	{
+		if(_chunks.empty())
+			return;
+
+		if(_chunks.size() > 1)
+		{
+			size_t reserved = getReservedBytes();
+
+			for(std::vector<Chunk>::iterator it = _chunks.begin(), end = _chunks.end(); it != end; ++it)
+				::operator delete((*it).pData);
+
+			_chunks.clear();
+
+			addChunk(reserved);
+		}
+
+		_pCurrent = _chunks.back().pData;
+		_available = _chunks.back().size;
+		_allocated = 0;
+	}
+
+	size_t getAllocatedBytes() const
+	{
+		return _allocated;
+	}
+
+	size_t getReservedBytes() const
+	{
+		size_t reserved = 0;
+
+		for(std::vector<Chunk>::const_iterator it = _chunks.begin(), end = _chunks.end(); it != end; ++it)
+			reserved += (*it).size;
+
+		return reserved;
+	}
+};
+
+// Standard allocator adaptor over a BoardArena, so standard containers can keep their nodes in the arena.
+// Deallocation is a no-op: the memory comes back when the arena is released.
+template<class ValueType>
+class ArenaAllocator
+{
+public:
+
+	typedef ValueType value_type;
+	typedef ValueType *pointer;
+	typedef const ValueType *const_pointer;
+	typedef ValueType &reference;
+	typedef const ValueType &const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<class OtherType> struct rebind
+	{
+		typedef ArenaAllocator<OtherType> other;
+	};
+
+	BoardArena *_pArena;
+
+	ArenaAllocator(BoardArena *pArena) : _pArena(pArena)
+	{
+	}
+
+	template<class OtherType> ArenaAllocator(const ArenaAllocator<OtherType> &copy) : _pArena(copy._pArena)
+	{
+	}
+
+	pointer address(reference value) const
+	{
+		return &value;
+	}
+
+	const_pointer address(const_reference value) const
+	{
+		return &value;
+	}
+
+	pointer allocate(size_type count, const void * = 0)
+	{
+		return static_cast<pointer>(_pArena->allocate(count * sizeof(ValueType)));
+	}
+
+	void deallocate(pointer, size_type)
+	{
+	}
+
+	size_type max_size() const
+	{
+		return size_type(-1) / sizeof(ValueType);
+	}
+
+	void construct(pointer p, const ValueType &value)
+	{
+		new(static_cast<void*>(p)) ValueType(value);
+	}
+
+	void destroy(pointer p)
+	{
+		p->~ValueType();
+	}
+
+	template<class OtherType> bool operator == (const ArenaAllocator<OtherType> &other) const
+	{
+		return _pArena == other._pArena;
+	}
+
+	template<class OtherType> bool operator != (const ArenaAllocator<OtherType> &other) const
+	{
+		return _pArena != other._pArena;
+	}
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "juce/juce_amalgamated.h"
+#include "SakuraMemory.h"
+
+// Wall-clock time of the named phases of a run, each phase ending where the next one starts.
+// The clock starts when the timer is constructed, so a static timer also covers the start of the process.
+class PhaseTimer
+{
+private:
+
+	enum
+	{
+		maxPhases = 32
+	};
+
+	struct Phase
+	{
+		const char *pName;
+		int64 ticks;
+	};
+
+	Phase _phases[maxPhases];
+	int _numPhases;
+	int64 _start;
+	int64 _last;
+
+public:
+
+	PhaseTimer()
+	{
+		restart();
+	}
+
+	void restart()
+	{
+		_numPhases = 0;
+		_start = _last = Time::getHighResolutionTicks();
+	}
+
+	// Ends the current phase under the given name; the name has to outlive the timer.
+	void mark(const char *pName)
+	{
+		int64 now = Time::getHighResolutionTicks();
+
+		if(_numPhases < maxPhases)
+		{
+			_phases[_numPhases].pName = pName;
+			_phases[_numPhases].ticks = now - _last;
+			_numPhases++;
+		}
+
+		_last = now;
+	}
+
+	int getNumPhases() const
+	{
+		return _numPhases;
+	}
+
+	const char *getPhaseName(int index) const
+	{
+		return _phases[index].pName;
+	}
+
+	double getPhaseMilliseconds(int index) const
+	{
+		return Time::highResolutionTicksToSeconds(_phases[index].ticks) * 1000.;
+	}
+
+	double getTotalMilliseconds() const
+	{
+		return Time::highResolutionTicksToSeconds(_last - _start) * 1000.;
+	}
+
+	const String getReport() const
+	{
+		String report;
+
+		for(int index = 0; index < _numPhases; index++)
+			report << getPhaseName(index) << T(": ") << String(getPhaseMilliseconds(index), 2) << T(" ms\n");
+
+		report << T("total: ") << String(getTotalMilliseconds(), 2) << T(" ms\n");
+
+		return report;
+	}
+};
+
+// Hot-path counters behind the performance overlay: the last duration of every timed piece of a move,
+// and the totals of the last paint pass of the board view.
+// The timers and the frame accounting are compiled in only with SAKURA_PROFILING; without it
+// the SAKURA_PROFILE_ macros expand to nothing and every counter stays at zero.
+class ProfileCounters
+{
+public:
+
+	enum Counter
+	{
+		rotate,
+		liveness,
+		solvedCheck,
+		repaint,
+		alivePath,
+		generate,
+		numCounters
+	};
+
+private:
+
+	struct Frame
+	{
+		bool counted;
+		int64 start;
+		int cells;
+		int allocations;
+
+		int64 lastTicks;
+		int lastCells;
+		int lastAllocations;
+	};
+
+	// kept as milliseconds in a float: the engine thread records them and the overlay reads them,
+	// and a 64-bit count of ticks could be read half-written on a 32-bit build
+	static volatile float *milliseconds()
+	{
+		static volatile float __milliseconds[numCounters];
+
+		return __milliseconds;
+	}
+
+	static Frame &frame()
+	{
+		static Frame __frame;
+
+		return __frame;
+	}
+
+public:
+
+	static void record(Counter counter, int64 elapsed)
+	{
+		milliseconds()[counter] = float(Time::highResolutionTicksToSeconds(elapsed) * 1000.);
+	}
+
+	static double getMilliseconds(Counter counter)
+	{
+		return milliseconds()[counter];
+	}
+
+	// A frame is a paint pass of the board view; a frame that isn't counted leaves the last one on display.
+	static void beginFrame(bool counted)
+	{
+		Frame &current = frame();
+
+		current.counted = counted;
+		current.start = Time::getHighResolutionTicks();
+		current.cells = 0;
+		current.allocations = AllocationCounter::get();
+	}
+
+	static void countPaintedCell()
+	{
+		frame().cells++;
+	}
+
+	static void endFrame()
+	{
+		Frame &current = frame();
+
+		if(!current.counted)
+			return;
+
+		current.lastTicks = Time::getHighResolutionTicks() - current.start;
+		current.lastCells = current.cells;
+		current.lastAllocations = AllocationCounter::get() - current.allocations;
+	}
+
+	static double getFrameMilliseconds()
+	{
+		return Time::highResolutionTicksToSeconds(frame().lastTicks) * 1000.;
+	}
+
+	static int getFramePaintedCells()
+	{
+		return frame().lastCells;
+	}
+
+	static int getFrameAllocations()
+	{
+		return frame().lastAllocations;
+	}
+};
+
+class ScopedProfileTimer
+{
+private:
+
+	ProfileCounters::Counter _counter;
+	int64 _start;
+
+public:
+
+	ScopedProfileTimer(ProfileCounters::Counter counter) :
+		_counter(counter),
+		_start(Time::getHighResolutionTicks())
+	{
+	}
+
+	~ScopedProfileTimer()
+	{
+		ProfileCounters::record(_counter, Time::getHighResolutionTicks() - _start);
+	}
+};
+
+#ifdef SAKURA_PROFILING
+#define SAKURA_PROFILE_SCOPE(counter) ScopedProfileTimer __profileScope_##counter(ProfileCounters::counter)
+#define SAKURA_PROFILE_BEGIN_FRAME(counted) ProfileCounters::beginFrame(counted)
+#define SAKURA_PROFILE_PAINTED_CELL() ProfileCounters::countPaintedCell()
+#define SAKURA_PROFILE_END_FRAME() ProfileCounters::endFrame()
+#else
+#define SAKURA_PROFILE_SCOPE(counter)
+#define SAKURA_PROFILE_BEGIN_FRAME(counted)
+#define SAKURA_PROFILE_PAINTED_CELL()
+#define SAKURA_PROFILE_END_FRAME()
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+
+#if JUCE_GCC
+	#define SAKURA_MEMORY_BARRIER() __sync_synchronize()
+#else
+	#include <intrin.h>
+
+	// x86 may let a load pass an earlier store, and the engine's idle handshake stores one flag and then loads the other,
+	// so this has to be a full fence for the processor as well as for the compiler
+	#define SAKURA_MEMORY_BARRIER() do { _ReadWriteBarrier(); _mm_mfence(); _ReadWriteBarrier(); } while(0)
+#endif
+
+// Lock-free ring between exactly one producer thread and one consumer thread.
+// Each side only writes its own counter, and a slot is filled (or read) in place before the counter moves past it,
+// so the vectors of a slot keep their storage from one round to the next.
+template<class T, int capacity>
+class SpscQueue
+{
+private:
+
+	T _slots[capacity];
+	volatile uint32 _written;
+	volatile uint32 _read;
+
+	SpscQueue(const SpscQueue &);
+	SpscQueue &operator = (const SpscQueue &);
+
+public:
+
+	SpscQueue() : _written(0), _read(0)
+	{
+		static_jassert((capacity & (capacity - 1)) == 0);
+	}
+
+	// Producer: the slot to fill next, or 0 while the queue is full; commitWrite() hands it over.
+	T *getWriteSlot()
+	{
+		if(_written - _read >= uint32(capacity))
+			return 0;
+
+		return &_slots[_written & (capacity - 1)];
+	}
+
+	void commitWrite()
+	{
+		SAKURA_MEMORY_BARRIER();
+
+		_written = _written + 1;
+	}
+
+	bool push(const T &item)
+	{
+		T *pSlot = getWriteSlot();
+
+		if(!pSlot)
+			return false;
+
+		*pSlot = item;
+		commitWrite();
+
+		return true;
+	}
+
+	// Consumer: the oldest filled slot, or 0 while the queue is empty; commitRead() gives it back.
+	T *getReadSlot()
+	{
+		if(_read == _written)
+			return 0;
+
+		SAKURA_MEMORY_BARRIER();
+
+		return &_slots[_read & (capacity - 1)];
+	}
+
+	void commitRead()
+	{
+		SAKURA_MEMORY_BARRIER();
+
+		_read = _read + 1;
+	}
+
+	bool isEmpty() const
+	{
+		return _read == _written;
+	}
+};
@@ -0,0 +1,495 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraRender.h"
+#include "figures.h"
+#include "graphics.h"
+
+namespace
+{
+	// The figures by their directions (left, top, right, bottom), each dead, alive and solved.
+	struct FigureSource
+	{
+		const char *pDirections;
+		const unsigned char *pSvg[3];
+	};
+
+	const FigureSource __figureSources[] =
+	{
+		{ "1000", { _1000_SVG, _1000_LIVE_SVG, _1000_SOLVED_SVG } },
+		{ "0100", { _0100_SVG, _0100_LIVE_SVG, _0100_SOLVED_SVG } },
+		{ "0010", { _0010_SVG, _0010_LIVE_SVG, _0010_SOLVED_SVG } },
+		{ "0001", { _0001_SVG, _0001_LIVE_SVG, _0001_SOLVED_SVG } },
+		{ "1100", { _1100_SVG, _1100_LIVE_SVG, _1100_SOLVED_SVG } },
+		{ "0110", { _0110_SVG, _0110_LIVE_SVG, _0110_SOLVED_SVG } },
+		{ "0011", { _0011_SVG, _0011_LIVE_SVG, _0011_SOLVED_SVG } },
+		{ "1001", { _1001_SVG, _1001_LIVE_SVG, _1001_SOLVED_SVG } },
+		{ "1010", { _1010_SVG, _1010_LIVE_SVG, _1010_SOLVED_SVG } },
+		{ "0101", { _0101_SVG, _0101_LIVE_SVG, _0101_SOLVED_SVG } },
+		{ "1110", { _1110_SVG, _1110_LIVE_SVG, _1110_SOLVED_SVG } },
+		{ "0111", { _0111_SVG, _0111_LIVE_SVG, _0111_SOLVED_SVG } },
+		{ "1011", { _1011_SVG, _1011_LIVE_SVG, _1011_SOLVED_SVG } },
+		{ "1101", { _1101_SVG, _1101_LIVE_SVG, _1101_SOLVED_SVG } },
+	};
+
+	// The branch colours of the dead, alive and solved figures.
+	const uint32 __lodColours[3] = { 0xff7f4100, 0xffbf6200, 0xffff7ffe };
+
+	// The solid blocks of one procedurally drawn cell: an arm per connection, plus a dot for the ends.
+	struct LodShape
+	{
+		int numRects;
+		int rects[5][4];
+	};
+
+	void makeLodShapes(int size, LodShape shapes[16])
+	{
+		int thickness = jmax(1, size / 5);
+		int centre = (size - thickness) / 2;
+		int dot = jmax(thickness, size / 3);
+
+		for(int mask = 0; mask < 16; mask++)
+		{
+			LodShape &shape = shapes[mask];
+			int numArms = 0;
+
+			shape.numRects = 0;
+
+			for(int direction = 0; direction < 4; direction++)
+			{
+				if(!(mask & (1 << direction)))
+					continue;
+
+				int *pRect = shape.rects[shape.numRects++];
+
+				// left, top, right, bottom
+				pRect[0] = (direction == 2) ? centre : ((direction == 0) ? 0 : centre);
+				pRect[1] = (direction == 3) ? centre : ((direction == 1) ? 0 : centre);
+				pRect[2] = (direction == 0) ? centre + thickness : ((direction == 2) ? size : centre + thickness);
+				pRect[3] = (direction == 1) ? centre + thickness : ((direction == 3) ? size : centre + thickness);
+
+				numArms++;
+			}
+
+			if(numArms == 1)
+			{
+				int *pRect = shape.rects[shape.numRects++];
+
+				pRect[0] = pRect[1] = (size - dot) / 2;
+				pRect[2] = pRect[3] = ((size - dot) / 2) + dot;
+			}
+		}
+	}
+
+	Drawable *createDrawable(const unsigned char *pSvg)
+	{
+		XmlDocument document(String((const char*)pSvg));
+		XmlElement *pElement = document.getDocumentElement();
+
+		if(!pElement)
+			return 0;
+
+		Drawable *pDrawable = Drawable::createFromSVG(*pElement);
+		delete pElement;
+
+		return pDrawable;
+	}
+}
+
+BoardRenderer::BoardRenderer() :
+	_cellSize(0),
+	_pLodImage(0),
+	_rotationRasterized(false),
+	_decor_side_right(0),
+	_decor_side_left(0),
+	_decor_side_bottom(0),
+	_decor_conner_left(0),
+	_decor_conner_right(0),
+	_decor_conner_left_top(0),
+	_decor_conner_right_top(0),
+	_decor_butterfly_left(0),
+	_decor_title(0),
+	_ornamentsLoaded(false)
+{
+	std::fill(&_figures[0][0], &_figures[0][0] + (16 * 3), (Drawable*)0);
+	std::fill(&_figureImages[0][0], &_figureImages[0][0] + (16 * 3), (Image*)0);
+	std::fill(&_zoomImages[0][0][0], &_zoomImages[0][0][0] + (zoomLevels * 16 * 3), (Image*)0);
+	std::fill(_zoomRasterized, _zoomRasterized + zoomLevels, false);
+	std::fill(&_rotationImages[0][0][0], &_rotationImages[0][0][0] + (16 * 3 * (rotationFrames - 1)), (Image*)0);
+}
+
+BoardRenderer::~BoardRenderer()
+{
+	deleteFigureImages();
+	deleteZoomImages();
+	deleteRotationImages();
+
+	delete _pLodImage;
+
+	for(int mask = 0; mask < 16; mask++)
+		for(int state = 0; state < 3; state++)
+			delete _figures[mask][state];
+
+	delete _decor_side_right;
+	delete _decor_side_left;
+	delete _decor_side_bottom;
+	delete _decor_conner_left;
+	delete _decor_conner_right;
+	delete _decor_conner_left_top;
+	delete _decor_conner_right_top;
+	delete _decor_butterfly_left;
+	delete _decor_title;
+}
+
+void BoardRenderer::deleteFigureImages()
+{
+	for(int mask = 0; mask < 16; mask++)
+		for(int state = 0; state < 3; state++)
+			deleteAndZero(_figureImages[mask][state]);
+}
+
+void BoardRenderer::deleteZoomImages()
+{
+	std::fill(_zoomRasterized, _zoomRasterized + zoomLevels, false);
+
+	for(int level = 0; level < zoomLevels; level++)
+		for(int mask = 0; mask < 16; mask++)
+			for(int state = 0; state < 3; state++)
+				deleteAndZero(_zoomImages[level][mask][state]);
+}
+
+void BoardRenderer::deleteRotationImages()
+{
+	_rotationRasterized = false;
+
+	for(int mask = 0; mask < 16; mask++)
+		for(int state = 0; state < 3; state++)
+			for(int frame = 0; frame < rotationFrames - 1; frame++)
+				deleteAndZero(_rotationImages[mask][state][frame]);
+}
+
+void BoardRenderer::rasterizeRotationFrames()
+{
+	SAKURA_TRACE_SCOPE_ARG("rasterizeRotationFrames", _cellSize);
+
+	float centre = _cellSize * .5f;
+
+	for(int mask = 0; mask < 16; mask++)
+		for(int state = 0; state < 3; state++)
+		{
+			if(!_figureImages[mask][state])
+				continue;
+
+			for(int frame = 1; frame < rotationFrames; frame++)
+			{
+				Image *pImage = new Image(Image::ARGB, _cellSize, _cellSize, true);
+				Graphics g(*pImage);
+
+				// a turn to the left is anticlockwise on the screen
+				g.drawImageTransformed(_figureImages[mask][state], 0, 0, _cellSize, _cellSize,
+					AffineTransform::rotation(-float_Pi * .5f * frame / rotationFrames, centre, centre), false);
+
+				_rotationImages[mask][state][frame - 1] = pImage;
+			}
+		}
+
+	_rotationRasterized = true;
+}
+
+void BoardRenderer::rasterizeFigures(Image *images[16][3], int cellSize)
+{
+	SAKURA_TRACE_SCOPE_ARG("rasterizeFigures", cellSize);
+
+	for(int mask = 0; mask < 16; mask++)
+		for(int state = 0; state < 3; state++)
+		{
+			if(!_figures[mask][state])
+				continue;
+
+			Image *pImage = new Image(Image::ARGB, cellSize, cellSize, true);
+			Graphics g(*pImage);
+
+			_figures[mask][state]->drawWithin(g, 0, 0, cellSize, cellSize, RectanglePlacement::stretchToFit);
+			images[mask][state] = pImage;
+		}
+}
+
+void BoardRenderer::loadFigures()
+{
+	for(size_t idx = 0; idx < sizeof(__figureSources) / sizeof(__figureSources[0]); idx++)
+	{
+		DirectionSetType figureDirections;
+
+		for(const char *pDirection = __figureSources[idx].pDirections; *pDirection; pDirection++)
+			figureDirections.push_back(*pDirection == '1');
+
+		int mask = CellDirections(figureDirections).getMask();
+
+		for(int state = 0; state < 3; state++)
+		{
+			delete _figures[mask][state];
+			_figures[mask][state] = createDrawable(__figureSources[idx].pSvg[state]);
+		}
+	}
+
+	// the images have to be drawn from the new figures
+	deleteZoomImages();
+
+	int cellSize = _cellSize;
+	_cellSize = 0;
+
+	if(cellSize)
+		setCellSize(cellSize);
+}
+
+void BoardRenderer::loadDecor()
+{
+	delete _decor_side_right;
+	delete _decor_side_left;
+	delete _decor_side_bottom;
+	delete _decor_conner_left;
+	delete _decor_conner_right;
+	delete _decor_conner_left_top;
+	delete _decor_conner_right_top;
+
+	_decor_side_right = createDrawable(SIDE_RIGHT_SVG);
+	_decor_side_left = createDrawable(SIDE_LEFT_SVG);
+	_decor_side_bottom = createDrawable(SIDE_BOTTOM_SVG);
+	_decor_conner_left = createDrawable(BORDER_CONNER_LEFT_SVG);
+	_decor_conner_right = createDrawable(BORDER_CONNER_RIGHT_SVG);
+	_decor_conner_left_top = createDrawable(BORDER_CONNER_LEFT_TOP_SVG);
+	_decor_conner_right_top = createDrawable(BORDER_CONNER_RIGHT_TOP_SVG);
+}
+
+void BoardRenderer::loadOrnaments()
+{
+	delete _decor_butterfly_left;
+	delete _decor_title;
+
+	_decor_butterfly_left = createDrawable(BUTTERFLY_LEFT_SVG);
+	_decor_title = createDrawable(SAKURA_TITLE_SVG);
+
+	_ornamentsLoaded = true;
+}
+
+void BoardRenderer::setCellSize(int cellSize)
+{
+	if(cellSize == _cellSize)
+		return;
+
+	deleteFigureImages();
+	deleteRotationImages();
+
+	_cellSize = cellSize;
+
+	rasterizeFigures(_figureImages, cellSize);
+}
+
+void BoardRenderer::paintZoomedCell(Graphics &g, int x, int y, int size, const Cell &cell, int state, bool drawOriginal, bool drawFocus)
+{
+	if(size == _cellSize)
+	{
+		paintCell(g, x, y, cell, state, drawOriginal, drawFocus);
+		return;
+	}
+
+	int level = 0;
+
+	while(level < zoomLevels - 1 && (smallestZoomSize << level) < size)
+		level++;
+
+	if(!_zoomRasterized[level])
+	{
+		rasterizeFigures(_zoomImages[level], smallestZoomSize << level);
+		_zoomRasterized[level] = true;
+	}
+
+	const Image *pImage = _zoomImages[level][cell.getMask(drawOriginal)][drawOriginal ? int(SakuraBoard::Alive) : state];
+
+	if(pImage)
+		g.drawImage(pImage, x, y, size, size, 0, 0, pImage->getWidth(), pImage->getHeight(), false);
+
+	if(drawFocus)
+	{
+		g.setColour(Colours::crimson);
+		g.drawRect(x, y, size, size);
+	}
+}
+
+void BoardRenderer::paintRotatingCell(Graphics &g, int x, int y, int size, int mask, int state, int frame, bool drawFocus)
+{
+	if(frame && !_rotationRasterized)
+		rasterizeRotationFrames();
+
+	const Image *pImage = frame ? _rotationImages[mask][state][frame - 1] : _figureImages[mask][state];
+
+	if(pImage)
+	{
+		if(size == _cellSize)
+			g.drawImageAt(pImage, x, y, false);
+		else
+			g.drawImage(pImage, x, y, size, size, 0, 0, _cellSize, _cellSize, false);
+	}
+
+	if(drawFocus)
+	{
+		g.setColour(Colours::crimson);
+		g.drawRect(x, y, size, size);
+	}
+}
+
+void BoardRenderer::blitRotatingCell(Image &target, int x, int y, int mask, int state, int frame)
+{
+	if(frame && !_rotationRasterized)
+		rasterizeRotationFrames();
+
+	const Image *pImage = frame ? _rotationImages[mask][state][frame - 1] : _figureImages[mask][state];
+
+	if(pImage)
+		PixelBlitter::blendImage(target, x, y, *pImage);
+}
+
+void BoardRenderer::paintLodCells(Graphics &g, const BoardSnapshot &board, int left, int top, int right, int bottom, int size, bool drawOriginal)
+{
+	int width = (right - left) * size;
+	int height = (bottom - top) * size;
+
+	if(width <= 0 || height <= 0)
+		return;
+
+	SAKURA_TRACE_SCOPE_ARG("paintLodCells", (right - left) * (bottom - top));
+
+	if(!_pLodImage || _pLodImage->getWidth() < width || _pLodImage->getHeight() < height)
+	{
+		int imageWidth = _pLodImage ? jmax(width, _pLodImage->getWidth()) : width;
+		int imageHeight = _pLodImage ? jmax(height, _pLodImage->getHeight()) : height;
+
+		delete _pLodImage;
+		_pLodImage = new Image(Image::ARGB, imageWidth, imageHeight, false);
+	}
+
+	LodShape shapes[16];
+	makeLodShapes(size, shapes);
+
+	int lineStride = 0;
+	int pixelStride = 0;
+	uint8 *pPixels = _pLodImage->lockPixelDataReadWrite(0, 0, width, height, lineStride, pixelStride);
+
+	jassert(pixelStride == sizeof(uint32));
+
+	for(int y = 0; y < height; y++)
+		memset(pPixels + (y * lineStride), 0, width * sizeof(uint32));
+
+	for(int cellY = top; cellY < bottom; cellY++)
+	{
+		uint8 *pRow = pPixels + ((cellY - top) * size * lineStride);
+
+		for(int cellX = left; cellX < right; cellX++)
+		{
+			const LodShape &shape = shapes[board.getCell(cellX, cellY).getMask(drawOriginal)];
+			uint32 colour = __lodColours[drawOriginal ? int(SakuraBoard::Alive) : board.getLive(cellX, cellY)];
+			uint32 *pCell = reinterpret_cast<uint32*>(pRow) + ((cellX - left) * size);
+
+			for(int idx = 0; idx < shape.numRects; idx++)
+			{
+				const int *pRect = shape.rects[idx];
+
+				for(int y = pRect[1]; y < pRect[3]; y++)
+				{
+					uint32 *pPixel = reinterpret_cast<uint32*>(reinterpret_cast<uint8*>(pCell) + (y * lineStride));
+
+					for(int x = pRect[0]; x < pRect[2]; x++)
+						pPixel[x] = colour;
+				}
+			}
+		}
+	}
+
+	_pLodImage->releasePixelDataReadWrite(pPixels);
+
+	// over the figures the lines fade out as the cells grow, so neither takes over at once
+	g.setOpacity(needsFigures(size) ? float(lodFadeSize - size) / float(lodFadeSize - lodSize + 1) : 1.f);
+	g.drawImage(_pLodImage, left * size, top * size, width, height, 0, 0, width, height, false);
+	g.setOpacity(1.f);
+}
+
+void BoardRenderer::paintBackground(Graphics &g, int numberOfCellsX, int numberOfCellsY, int statusBarHeight, int windowWidth, int windowHeight, bool drawGrid) const
+{
+	int width = _cellSize * numberOfCellsX + (_cellSize * 2);
+	int bkWidth = windowWidth;
+	int height = windowHeight;
+
+	GradientBrush mbrush(Colours::skyblue, 0, 0, Colour(0xffffea95), 0, height, false);
+	g.setBrush(&mbrush);
+	g.fillAll();
+
+	GradientBrush dividerBrush(Colours::skyblue, 0, height, Colour(0xffffea95), .0f, 0.f, false);
+	g.setBrush(&dividerBrush);
+	g.fillRect(width, 0, 1, height);
+
+	Image im(Image::ARGB, bkWidth, height, true);
+	Graphics gg(im);
+
+	_decor_side_right->drawWithin(gg, width - _cellSize, _cellSize, _cellSize, height - _cellSize - statusBarHeight, RectanglePlacement::onlyReduceInSize);
+	_decor_side_left->drawWithin(gg, 0, 0, _cellSize, height - _cellSize - statusBarHeight, RectanglePlacement::onlyReduceInSize);
+	_decor_side_bottom->drawWithin(gg, 0, height - _cellSize - statusBarHeight, width - _cellSize, _cellSize, RectanglePlacement::onlyReduceInSize);
+
+	_decor_conner_left->drawWithin(gg, 0, height - (_cellSize * 2) - statusBarHeight, _cellSize * 2, _cellSize * 2, RectanglePlacement::onlyReduceInSize);
+	_decor_conner_right->drawWithin(gg, width - (_cellSize * 2), height - (_cellSize * 2) - statusBarHeight, _cellSize * 2, _cellSize * 2, RectanglePlacement::onlyReduceInSize);
+	_decor_conner_left_top->drawWithin(gg, 0, 0, _cellSize * 2, _cellSize * 2, RectanglePlacement::onlyReduceInSize);
+	_decor_conner_right_top->drawWithin(gg, width - (_cellSize * 2), 0, _cellSize * 2, _cellSize * 2, RectanglePlacement::onlyReduceInSize);
+
+	GradientBrush brush(Colours::cornsilk, _cellSize, _cellSize, Colour(0xffffea95), _cellSize, numberOfCellsY * _cellSize, false);
+	gg.setBrush(&brush);
+	gg.fillRoundedRectangle(_cellSize, _cellSize, numberOfCellsX * _cellSize, numberOfCellsY * _cellSize, 10);
+	gg.setColour(Colours::yellowgreen.brighter());
+	gg.drawRoundedRectangle(_cellSize, _cellSize, numberOfCellsX * _cellSize, numberOfCellsY * _cellSize, 10, 1);
+
+	gg.setOpacity(.3f);
+
+	if(drawGrid)
+	{
+		for(int x_ = 1; x_ < numberOfCellsX; x_++)
+			gg.drawVerticalLine(_cellSize + (x_ * _cellSize), _cellSize, height - _cellSize - statusBarHeight);
+
+		for(int y_ = 1; y_ < numberOfCellsY; y_++)
+			gg.drawHorizontalLine(_cellSize + (y_ * _cellSize), _cellSize, width - _cellSize);
+	}
+
+	gg.setOpacity(1.f);
+
+	if(_decor_butterfly_left)
+		_decor_butterfly_left->drawWithin(gg, width - _cellSize - (_cellSize / 4), (_cellSize * 2) - (_cellSize / 4), _cellSize / 2, _cellSize / 2, RectanglePlacement::onlyReduceInSize);
+
+	gg.setOpacity(.7f);
+
+	if(_decor_title)
+		_decor_title->drawWithin(gg, 10, 10, width - 20, _cellSize - 20, RectanglePlacement::onlyIncreaseInSize);
+
+	DropShadowEffect eff;
+	eff.applyEffect(im, g);
+}
+
+void BoardRenderer::paintCells(Graphics &g, int left, int top, const SakuraBoard &board, bool drawOriginal) const
+{
+	for(int y = 0; y < board.getHeight(); y++)
+		for(int x = 0; x < board.getWidth(); x++)
+			paintCell(g, left + (x * _cellSize), top + (y * _cellSize), board.getCell(x, y), board.getLive(x, y), drawOriginal, false);
+}
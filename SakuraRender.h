@@ -0,0 +1,167 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "juce/juce_amalgamated.h"
+#include "SakuraBoard.h"
+#include "SakuraBlit.h"
+#include "SakuraSnapshot.h"
+
+// Paints a board without any component: the background with its decor and the cell figures.
+// The figures are parsed from SVG once and rasterized again whenever the cell size changes,
+// so the matrix and the offscreen benchmarks draw exactly the same pixels.
+class BoardRenderer
+{
+public:
+
+	// Below lodFadeSize pixels the cells are also drawn procedurally, over the figures and more opaque the smaller they are;
+	// below lodSize only procedurally.
+	enum
+	{
+		lodSize = 10,
+		lodFadeSize = 14
+	};
+
+	// A quarter turn is shown in this many steps, frame 0 being the figure itself.
+	enum
+	{
+		rotationFrames = 6
+	};
+
+	static bool needsFigures(int size)
+	{
+		return size >= lodSize;
+	}
+
+	static bool needsLod(int size)
+	{
+		return size < lodFadeSize;
+	}
+
+private:
+
+	// zoomed cells are scaled from figures rasterized at 8, 16, ... 256 pixels
+	enum
+	{
+		zoomLevels = 6,
+		smallestZoomSize = 8
+	};
+
+	Drawable *_figures[16][3];
+	Image *_figureImages[16][3];
+	Image *_zoomImages[zoomLevels][16][3];
+	bool _zoomRasterized[zoomLevels];
+	int _cellSize;
+
+	// the procedurally drawn cells, kept from frame to frame
+	Image *_pLodImage;
+
+	// the in-between frames of a quarter turn, rasterized from the figure images the first time a cell turns
+	Image *_rotationImages[16][3][rotationFrames - 1];
+	bool _rotationRasterized;
+
+	Drawable *_decor_side_right;
+	Drawable *_decor_side_left;
+	Drawable *_decor_side_bottom;
+	Drawable *_decor_conner_left;
+	Drawable *_decor_conner_right;
+	Drawable *_decor_conner_left_top;
+	Drawable *_decor_conner_right_top;
+	Drawable *_decor_butterfly_left;
+	Drawable *_decor_title;
+	bool _ornamentsLoaded;
+
+	void deleteFigureImages();
+	void deleteZoomImages();
+	void rasterizeFigures(Image *images[16][3], int cellSize);
+	void deleteRotationImages();
+	void rasterizeRotationFrames();
+
+	BoardRenderer(const BoardRenderer &);
+	BoardRenderer &operator = (const BoardRenderer &);
+
+public:
+
+	BoardRenderer();
+	~BoardRenderer();
+
+	void loadFigures();
+
+	// The frame around the board is needed for the first frame; the title and the butterfly can come later,
+	// the background is just painted without them until they are loaded.
+	void loadDecor();
+	void loadOrnaments();
+
+	bool hasOrnaments() const
+	{
+		return _ornamentsLoaded;
+	}
+
+	// Rasterizes the figures for the cell size, unless they already have it.
+	void setCellSize(int cellSize);
+
+	int getCellSize() const
+	{
+		return _cellSize;
+	}
+
+	// The background of a whole matrix window: the decor, the board frame and the grid.
+	// A scrolled board draws its own grid, so it moves with the cells.
+	void paintBackground(Graphics &g, int numberOfCellsX, int numberOfCellsY, int statusBarHeight, int windowWidth, int windowHeight, bool drawGrid = true) const;
+
+	// state is a SakuraBoard::CellState; the original directions are always drawn alive, as the peek mode shows them.
+	void paintCell(Graphics &g, int x, int y, const Cell &cell, int state, bool drawOriginal, bool drawFocus) const
+	{
+		g.drawImageAt(_figureImages[cell.getMask(drawOriginal)][drawOriginal ? int(SakuraBoard::Alive) : state], x, y, false);
+
+		if(drawFocus)
+		{
+			g.setColour(Colours::crimson);
+			g.drawRect(x, y, _cellSize, _cellSize);
+		}
+	}
+
+	// Paints a cell at any size. The cell size itself is drawn as it is; any other size is scaled down from the nearest
+	// larger zoom level, which is rasterized the first time it is needed and kept, so zooming doesn't rasterize every step.
+	void paintZoomedCell(Graphics &g, int x, int y, int size, const Cell &cell, int state, bool drawOriginal, bool drawFocus);
+
+	// The cell size figures composited straight into an ARGB image by the PixelBlitter kernel rather than through a Graphics.
+	void blitCell(Image &target, int x, int y, const Cell &cell, int state, bool drawOriginal) const
+	{
+		const Image *pImage = _figureImages[cell.getMask(drawOriginal)][drawOriginal ? int(SakuraBoard::Alive) : state];
+
+		if(pImage)
+			PixelBlitter::blendImage(target, x, y, *pImage);
+	}
+
+	void blitRotatingCell(Image &target, int x, int y, int mask, int state, int frame);
+
+	// Paints the figure for mask turned frame / rotationFrames of a quarter turn to the left.
+	void paintRotatingCell(Graphics &g, int x, int y, int size, int mask, int state, int frame, bool drawFocus);
+
+	// Draws the cells from (left, top) to (right, bottom), exclusive, as solid lines coloured by their state,
+	// written straight into a pixel buffer and blitted at once; cell (left, top) lands at (left * size, top * size).
+	void paintLodCells(Graphics &g, const BoardSnapshot &board, int left, int top, int right, int bottom, int size, bool drawOriginal);
+
+	// Paints every cell of the board with its live state, the top-left cell at (left, top).
+	void paintCells(Graphics &g, int left, int top, const SakuraBoard &board, bool drawOriginal) const;
+};
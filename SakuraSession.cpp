@@ -0,0 +1,371 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "SakuraSession.h"
+#include "SakuraEngine.h"
+
+bool SessionRecorder::start(const File &file, const SakuraBoard &board)
+{
+	stop();
+
+	file.getParentDirectory().createDirectory();
+	file.deleteFile();
+
+	_pOut = new FileOutputStream(file, 64 * 1024);
+
+	if(_pOut->failedToOpen())
+	{
+		deleteAndZero(_pOut);
+		return false;
+	}
+
+	_pOut->write("SKRE", 4);
+	_pOut->writeShort(short(SessionLog::version));
+	_pOut->writeShort(0);
+
+	_lastEventTime = Time::getMillisecondCounter();
+
+	recordLoad(board);
+
+	return isRecording();
+}
+
+void SessionRecorder::stop()
+{
+	if(!_pOut)
+		return;
+
+	_pOut->flush();
+
+	deleteAndZero(_pOut);
+}
+
+void SessionRecorder::beginEvent(int type)
+{
+	uint32 now = Time::getMillisecondCounter();
+
+	_event.clear();
+	_event.push_back(uint8(type));
+	writeVarInt(_event, now - _lastEventTime);
+
+	_lastEventTime = now;
+}
+
+void SessionRecorder::endEvent()
+{
+	if(!_pOut->write(&_event[0], int(_event.size())))
+		stop();
+}
+
+void SessionRecorder::recordGenerate(int width, int height, int rootX, int rootY, bool infiniteMode, double relax, uint32 seed)
+{
+	if(!_pOut)
+		return;
+
+	beginEvent(SessionLog::generateEvent);
+	writeVarInt(_event, uint32(width));
+	writeVarInt(_event, uint32(height));
+	writeVarInt(_event, uint32(rootX));
+	writeVarInt(_event, uint32(rootY));
+	writeVarInt(_event, infiniteMode ? SessionLog::infiniteModeFlag : 0);
+	writeVarInt(_event, uint32(relax * 1000. + .5));
+	writeVarInt(_event, seed);
+	endEvent();
+}
+
+void SessionRecorder::recordShuffle(uint32 seed)
+{
+	if(!_pOut)
+		return;
+
+	beginEvent(SessionLog::shuffleEvent);
+	writeVarInt(_event, seed);
+	endEvent();
+}
+
+void SessionRecorder::recordRotate(int cellIndex, int leftTurns)
+{
+	if(!_pOut)
+		return;
+
+	beginEvent(SessionLog::rotateEvent);
+	writeVarInt(_event, uint32(cellIndex));
+	writeVarInt(_event, uint32(leftTurns & 3));
+	endEvent();
+}
+
+void SessionRecorder::recordUndo()
+{
+	if(!_pOut)
+		return;
+
+	beginEvent(SessionLog::undoEvent);
+	endEvent();
+}
+
+void SessionRecorder::recordRedo()
+{
+	if(!_pOut)
+		return;
+
+	beginEvent(SessionLog::redoEvent);
+	endEvent();
+}
+
+void SessionRecorder::recordPeek(bool on)
+{
+	if(!_pOut)
+		return;
+
+	beginEvent(SessionLog::peekEvent);
+	writeVarInt(_event, on ? 1 : 0);
+	endEvent();
+}
+
+void SessionRecorder::recordLoad(const SakuraBoard &board)
+{
+	if(!_pOut)
+		return;
+
+	board.getState(_state);
+
+	// a board the codec can't store would make the rest of the session meaningless
+	if(!PuzzleCodec::encode(_state, true, _encoded))
+	{
+		stop();
+		return;
+	}
+
+	beginEvent(SessionLog::loadEvent);
+	writeVarInt(_event, uint32(_encoded.size()));
+	_event.insert(_event.end(), _encoded.begin(), _encoded.end());
+	endEvent();
+}
+
+namespace
+{
+	uint64 ticksToNanoseconds(int64 ticks)
+	{
+		static const double __nanosecondsPerTick = 1e9 / double(Time::getHighResolutionTicksPerSecond());
+
+		return uint64(double(ticks) * __nanosecondsPerTick + .5);
+	}
+
+	// Stands in for the matrix: every result's snapshot is shown, so the engine frees the ones before it as in the game.
+	class ReplayListener : public GameEngine::Listener
+	{
+	private:
+
+		SessionReplayer::Statistics &_statistics;
+		GameEngine *_pEngine;
+
+		ReplayListener(const ReplayListener &);
+		ReplayListener &operator = (const ReplayListener &);
+
+	public:
+
+		ReplayListener(SessionReplayer::Statistics &statistics) :
+			_statistics(statistics),
+			_pEngine(0)
+		{
+		}
+
+		void setEngine(GameEngine *pEngine)
+		{
+			_pEngine = pEngine;
+		}
+
+		void engineResult(EngineResult &result)
+		{
+			if(result.solved)
+				_statistics.solved++;
+
+			if(result.pSnapshot)
+				_pEngine->releaseSnapshotsBefore(result.pSnapshot);
+		}
+	};
+
+	// From the post to the result handed back, as the matrix waits for it.
+	uint64 runCommand(GameEngine &engine, const EngineCommand &command)
+	{
+		int64 start = Time::getHighResolutionTicks();
+
+		engine.post(command);
+		engine.waitUntilIdle();
+
+		return ticksToNanoseconds(Time::getHighResolutionTicks() - start);
+	}
+}
+
+bool SessionReplayer::replay(const uint8 *pData, size_t size, SakuraBoard &board, Statistics &statistics)
+{
+	const uint8 *pEnd = pData + size;
+
+	if(size < size_t(SessionLog::headerSize) || memcmp(pData, "SKRE", 4) != 0 ||
+		littleEndianShort((const char*)pData + 4) != SessionLog::version)
+		return false;
+
+	pData += SessionLog::headerSize;
+
+	ReplayListener listener(statistics);
+	GameEngine engine(board, &listener);
+
+	listener.setEngine(&engine);
+	engine.startThread();
+
+	BoardState state;
+
+	// every event waits for its result, so the board is the replayer's own between them
+	while(pData < pEnd)
+	{
+		int type = *pData++;
+		uint32 delay = 0;
+
+		if(!readVarInt(pData, pEnd, delay))
+			return false;
+
+		switch(type)
+		{
+			case SessionLog::generateEvent:
+			{
+				uint32 width = 0, height = 0, rootX = 0, rootY = 0, flags = 0, relax = 0, seed = 0;
+
+				if(!readVarInt(pData, pEnd, width) || !readVarInt(pData, pEnd, height) ||
+					!readVarInt(pData, pEnd, rootX) || !readVarInt(pData, pEnd, rootY) ||
+					!readVarInt(pData, pEnd, flags) || !readVarInt(pData, pEnd, relax) ||
+					!readVarInt(pData, pEnd, seed))
+					return false;
+
+				if(width < 3 || height < 3 || width > 0xffff || height > 0xffff || rootX >= width || rootY >= height)
+					return false;
+
+				board.resize(int(width), int(height));
+				board.setRoot(int(rootX), int(rootY));
+
+				EngineCommand command(generateCommandId);
+				command.infiniteMode = (flags & SessionLog::infiniteModeFlag) != 0;
+				command.relax = relax / 1000.;
+				command.seed = seed;
+
+				statistics.generates.record(runCommand(engine, command));
+
+				break;
+			}
+
+			case SessionLog::shuffleEvent:
+			{
+				uint32 seed = 0;
+
+				if(!readVarInt(pData, pEnd, seed))
+					return false;
+
+				EngineCommand command(shuffleCommandId);
+				command.seed = seed;
+
+				statistics.shuffles.record(runCommand(engine, command));
+
+				break;
+			}
+
+			case SessionLog::rotateEvent:
+			case SessionLog::undoEvent:
+			case SessionLog::redoEvent:
+			{
+				uint32 cellIndex = 0;
+				uint32 leftTurns = 0;
+
+				if(type == SessionLog::rotateEvent)
+				{
+					if(!readVarInt(pData, pEnd, cellIndex) || !readVarInt(pData, pEnd, leftTurns))
+						return false;
+
+					if(cellIndex >= uint32(board.getNumCells()))
+						return false;
+				}
+
+				EngineCommand command(type == SessionLog::rotateEvent ? rotateLeftCommandId : (type == SessionLog::undoEvent ? undoCommandId : redoCommandId));
+
+				if(type == SessionLog::rotateEvent)
+				{
+					command.cellIndex = int(cellIndex);
+					command.leftTurns = int(leftTurns);
+				}
+
+				statistics.moves.record(runCommand(engine, command));
+
+				break;
+			}
+
+			case SessionLog::peekEvent:
+			{
+				uint32 on = 0;
+
+				if(!readVarInt(pData, pEnd, on))
+					return false;
+
+				break;
+			}
+
+			// loaded on the message thread and published, as the matrix loads a board
+			case SessionLog::loadEvent:
+			{
+				uint32 length = 0;
+
+				if(!readVarInt(pData, pEnd, length) || length > uint32(pEnd - pData))
+					return false;
+
+				int64 start = Time::getHighResolutionTicks();
+
+				if(!PuzzleCodec::decode(pData, length, state))
+					return false;
+
+				board.setState(state, &state.cells[0]);
+				board.drawAlivePath();
+				board.clearChangedCells();
+
+				engine.releaseSnapshotsBefore(engine.publishBoard());
+
+				statistics.loads.record(ticksToNanoseconds(Time::getHighResolutionTicks() - start));
+
+				pData += length;
+
+				break;
+			}
+
+			default:
+				return false;
+		}
+
+		statistics.events++;
+	}
+
+	return true;
+}
+
+bool SessionReplayer::replay(const File &file, SakuraBoard &board, Statistics &statistics)
+{
+	MappedFile session;
+
+	if(!session.open(file))
+		return false;
+
+	return replay(session.getData(), session.getSize(), board, statistics);
+}
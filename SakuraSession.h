@@ -0,0 +1,134 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "SakuraBoard.h"
+#include "SakuraCodec.h"
+#include "SakuraHistogram.h"
+
+#include <vector>
+
+// Recorded game session: the player's input, not the resulting boards, so a replay runs through the same board code.
+//
+// Layout: "SKRE", int16 version, int16 reserved, then the events. Every event is a type byte, followed by
+// the milliseconds since the previous event and the event's arguments, all as variable-length integers:
+//   generate  width, height, root x, root y, flags (bit 0: infinite mode), relax value in thousandths, seed
+//   shuffle   seed
+//   rotate    cell index, left quarter-turns
+//   undo      -
+//   redo      -
+//   peek      1 when the peek mode was turned on, 0 when it was turned off
+//   load      size, then the board compressed by PuzzleCodec (with the shuffle)
+// A session starts with a load event of the board it was recorded on.
+class SessionLog
+{
+public:
+
+	enum
+	{
+		version = 1,
+		headerSize = 8,
+		infiniteModeFlag = 1
+	};
+
+	enum EventType
+	{
+		generateEvent = 1,
+		shuffleEvent,
+		rotateEvent,
+		undoEvent,
+		redoEvent,
+		peekEvent,
+		loadEvent
+	};
+};
+
+class SessionRecorder
+{
+private:
+
+	FileOutputStream *_pOut;
+	std::vector<uint8> _event;
+	std::vector<uint8> _encoded;
+	BoardState _state;
+	uint32 _lastEventTime;
+
+	void beginEvent(int type);
+	void endEvent();
+
+public:
+
+	SessionRecorder() : _pOut(0), _lastEventTime(0)
+	{
+	}
+
+	~SessionRecorder()
+	{
+		stop();
+	}
+
+	// Starts a new file with the given board as its first event.
+	bool start(const File &file, const SakuraBoard &board);
+	void stop();
+
+	bool isRecording() const
+	{
+		return _pOut != 0;
+	}
+
+	// The root is the one the branch grew around, the board's root before the generation.
+	void recordGenerate(int width, int height, int rootX, int rootY, bool infiniteMode, double relax, uint32 seed);
+	void recordShuffle(uint32 seed);
+	void recordRotate(int cellIndex, int leftTurns);
+	void recordUndo();
+	void recordRedo();
+	void recordPeek(bool on);
+	void recordLoad(const SakuraBoard &board);
+};
+
+// Plays a session back on a board without any user interface, as fast as it goes, timing every event.
+// The commands go through a GameEngine of their own, as the matrix posts them, so a move is timed with its snapshot
+// and its hint update; only the painting and the peek mode are left out.
+class SessionReplayer
+{
+public:
+
+	// Latencies in nanoseconds, from posting a command to getting its result back; moves are rotations, undos and redos,
+	// each with its solved check. A load is decoded, traced and published on the calling thread, as the matrix does it.
+	struct Statistics
+	{
+		LatencyHistogram moves;
+		LatencyHistogram generates;
+		LatencyHistogram shuffles;
+		LatencyHistogram loads;
+		int events;
+		int solved;
+
+		Statistics() : events(0), solved(0)
+		{
+		}
+	};
+
+	// Returns false if the session is damaged; the statistics then cover the events before the damage.
+	static bool replay(const uint8 *pData, size_t size, SakuraBoard &board, Statistics &statistics);
+	static bool replay(const File &file, SakuraBoard &board, Statistics &statistics);
+};
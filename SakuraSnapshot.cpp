@@ -0,0 +1,247 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraSnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+
+SnapshotPublisher::SnapshotPublisher() :
+	_pLatest(new BoardSnapshot()),
+	_nextVersion(1),
+	_readerVersion(0)
+{
+}
+
+SnapshotPublisher::~SnapshotPublisher()
+{
+	for(std::vector<Retired>::iterator it = _retired.begin(), end = _retired.end(); it != end; ++it)
+	{
+		delete (*it).pSnapshot;
+		delete (*it).pTile;
+	}
+
+	for(std::vector<BoardTile*>::const_iterator it = _pLatest->_tiles.begin(), end = _pLatest->_tiles.end(); it != end; ++it)
+		delete *it;
+
+	for(std::vector<BoardTile*>::const_iterator it = _freeTiles.begin(), end = _freeTiles.end(); it != end; ++it)
+		delete *it;
+
+	for(std::vector<BoardSnapshot*>::const_iterator it = _freeSnapshots.begin(), end = _freeSnapshots.end(); it != end; ++it)
+		delete *it;
+
+	delete _pLatest;
+}
+
+BoardSnapshot *SnapshotPublisher::beginVersion(const SakuraBoard &board)
+{
+	BoardSnapshot *pNext = 0;
+
+	// a recycled snapshot keeps the capacity of its tile list
+	if(_freeSnapshots.empty())
+		pNext = new BoardSnapshot(*_pLatest);
+	else
+	{
+		pNext = _freeSnapshots.back();
+		_freeSnapshots.pop_back();
+
+		*pNext = *_pLatest;
+	}
+
+	pNext->_version = _nextVersion++;
+
+	if(board.getWidth() == _pLatest->_width && board.getHeight() == _pLatest->_height)
+		return pNext;
+
+	// another size: every tile starts afresh
+	for(std::vector<BoardTile*>::const_iterator it = _pLatest->_tiles.begin(), end = _pLatest->_tiles.end(); it != end; ++it)
+		retire(0, *it);
+
+	pNext->_width = board.getWidth();
+	pNext->_height = board.getHeight();
+	pNext->_tilesX = (pNext->_width + BoardTile::size - 1) >> BoardTile::sizeShift;
+	pNext->_tiles.assign(pNext->_tilesX * ((pNext->_height + BoardTile::size - 1) >> BoardTile::sizeShift), static_cast<BoardTile*>(0));
+
+	return pNext;
+}
+
+void SnapshotPublisher::endVersion(BoardSnapshot *pNext)
+{
+	retire(_pLatest, 0);
+
+	SAKURA_MEMORY_BARRIER();
+
+	_pLatest = pNext;
+
+	reclaim();
+}
+
+// The tile of the new version that may be written; the first write to a shared tile copies it.
+BoardTile *SnapshotPublisher::copyTile(BoardSnapshot *pNext, int tileIndex)
+{
+	BoardTile *pTile = pNext->_tiles[tileIndex];
+
+	if(!pTile)
+		return pNext->_tiles[tileIndex] = allocateTile();
+
+	if(tileIndex >= int(_pLatest->_tiles.size()) || pTile != _pLatest->_tiles[tileIndex])
+		return pTile;
+
+	retire(0, pTile);
+
+	BoardTile *pCopy = allocateTile();
+	*pCopy = *pTile;
+
+	return pNext->_tiles[tileIndex] = pCopy;
+}
+
+// The contents are left as they were; every caller writes the whole tile or copies one over it.
+BoardTile *SnapshotPublisher::allocateTile()
+{
+	if(_freeTiles.empty())
+		return new BoardTile();
+
+	BoardTile *pTile = _freeTiles.back();
+	_freeTiles.pop_back();
+
+	return pTile;
+}
+
+void SnapshotPublisher::retire(BoardSnapshot *pSnapshot, BoardTile *pTile)
+{
+	Retired retired = { _nextVersion - 1, pSnapshot, pTile };
+
+	_retired.push_back(retired);
+}
+
+void SnapshotPublisher::reclaim()
+{
+	uint32 readerVersion = _readerVersion;
+	size_t kept = 0;
+
+	SAKURA_MEMORY_BARRIER();
+
+	for(size_t idx = 0; idx < _retired.size(); idx++)
+	{
+		Retired &retired = _retired[idx];
+
+		if(retired.version > readerVersion)
+		{
+			_retired[kept++] = retired;
+			continue;
+		}
+
+		// as many tiles as a whole-board publish takes, and the snapshots of a reader some way behind
+		if(retired.pSnapshot && _freeSnapshots.size() < maxFreeSnapshots)
+			_freeSnapshots.push_back(retired.pSnapshot);
+		else
+			delete retired.pSnapshot;
+
+		if(retired.pTile && _freeTiles.size() < _pLatest->_tiles.size() + maxFreeSnapshots)
+			_freeTiles.push_back(retired.pTile);
+		else
+			delete retired.pTile;
+	}
+
+	_retired.resize(kept);
+}
+
+const BoardSnapshot *SnapshotPublisher::publish(const SakuraBoard &board)
+{
+	SAKURA_TRACE_SCOPE_ARG("publishSnapshot", board.getNumCells());
+
+	BoardSnapshot *pNext = beginVersion(board);
+
+	const std::vector<Cell> &cells = board.getCells();
+	const std::vector<uint8> &live = board.getLiveStates();
+	int width = board.getWidth();
+	int height = board.getHeight();
+
+	for(int tileY = 0, tileIndex = 0; tileY < height; tileY += BoardTile::size)
+		for(int tileX = 0; tileX < width; tileX += BoardTile::size, tileIndex++)
+		{
+			int columns = jmin(int(BoardTile::size), width - tileX);
+			int rows = jmin(int(BoardTile::size), height - tileY);
+			const BoardTile *pTile = pNext->_tiles[tileIndex];
+			bool changed = !pTile;
+
+			for(int row = 0; row < rows && !changed; row++)
+			{
+				int cellIndex = ((tileY + row) * width) + tileX;
+
+				changed = memcmp(&pTile->cells[row << BoardTile::sizeShift], &cells[cellIndex], columns * sizeof(Cell)) != 0 ||
+					memcmp(&pTile->live[row << BoardTile::sizeShift], &live[cellIndex], columns) != 0;
+			}
+
+			if(!changed)
+				continue;
+
+			BoardTile *pCopy = copyTile(pNext, tileIndex);
+
+			for(int row = 0; row < rows; row++)
+			{
+				int cellIndex = ((tileY + row) * width) + tileX;
+
+				std::copy(cells.begin() + cellIndex, cells.begin() + cellIndex + columns, &pCopy->cells[row << BoardTile::sizeShift]);
+				memcpy(&pCopy->live[row << BoardTile::sizeShift], &live[cellIndex], columns);
+			}
+		}
+
+	endVersion(pNext);
+
+	return pNext;
+}
+
+const BoardSnapshot *SnapshotPublisher::publish(const SakuraBoard &board, const std::vector<int> &cellIndices)
+{
+	if(board.getWidth() != _pLatest->_width || board.getHeight() != _pLatest->_height)
+		return publish(board);
+
+	BoardSnapshot *pNext = beginVersion(board);
+	int width = board.getWidth();
+
+	for(std::vector<int>::const_iterator it = cellIndices.begin(), end = cellIndices.end(); it != end; ++it)
+	{
+		int x = *it % width;
+		int y = *it / width;
+		BoardTile *pTile = copyTile(pNext, pNext->getTileIndex(x, y));
+		int indexInTile = BoardSnapshot::getIndexInTile(x, y);
+
+		pTile->cells[indexInTile] = board.getCell(x, y);
+		pTile->live[indexInTile] = uint8(board.getLive(x, y));
+	}
+
+	endVersion(pNext);
+
+	return pNext;
+}
+
+size_t SnapshotPublisher::getMemoryUsage() const
+{
+	size_t tiles = _pLatest->_tiles.size();
+
+	for(std::vector<Retired>::const_iterator it = _retired.begin(), end = _retired.end(); it != end; ++it)
+		if((*it).pTile)
+			tiles++;
+
+	tiles += _freeTiles.size();
+
+	return (tiles * sizeof(BoardTile)) + ((_retired.size() + _freeSnapshots.size() + 1) * sizeof(BoardSnapshot)) + (_retired.capacity() * sizeof(Retired));
+}
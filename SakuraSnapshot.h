@@ -0,0 +1,167 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraBoard.h"
+#include "SakuraQueue.h"
+
+#include <vector>
+
+// A square of the board's cells, never changed once it is in a published snapshot.
+struct BoardTile
+{
+	enum
+	{
+		sizeShift = 6,
+		size = 1 << sizeShift,
+		cellsPerTile = size * size
+	};
+
+	Cell cells[cellsPerTile];
+	uint8 live[cellsPerTile];
+};
+
+// An immutable version of the board for painting. Consecutive versions share the tiles that didn't change,
+// so publishing a move copies only the tiles it touched.
+class BoardSnapshot
+{
+	friend class SnapshotPublisher;
+
+private:
+
+	uint32 _version;
+	int _width;
+	int _height;
+	int _tilesX;
+	std::vector<BoardTile*> _tiles;
+
+	int getTileIndex(int x, int y) const
+	{
+		return ((y >> BoardTile::sizeShift) * _tilesX) + (x >> BoardTile::sizeShift);
+	}
+
+	static int getIndexInTile(int x, int y)
+	{
+		return ((y & (BoardTile::size - 1)) << BoardTile::sizeShift) + (x & (BoardTile::size - 1));
+	}
+
+public:
+
+	BoardSnapshot() : _version(0), _width(0), _height(0), _tilesX(0)
+	{
+	}
+
+	uint32 getVersion() const
+	{
+		return _version;
+	}
+
+	int getWidth() const
+	{
+		return _width;
+	}
+
+	int getHeight() const
+	{
+		return _height;
+	}
+
+	int getNumCells() const
+	{
+		return _width * _height;
+	}
+
+	const Cell &getCell(int x, int y) const
+	{
+		return _tiles[getTileIndex(x, y)]->cells[getIndexInTile(x, y)];
+	}
+
+	int getLive(int x, int y) const
+	{
+		return _tiles[getTileIndex(x, y)]->live[getIndexInTile(x, y)];
+	}
+};
+
+// Publishes the snapshots of one board for one reader, and frees them by epochs: a snapshot or a tile replaced
+// by version N is only referenced by older versions, so it goes once the reader has moved on to N or later.
+// The reader only ever moves forward, and the versions it hasn't reached yet are newer still.
+// What goes is kept for the next versions rather than freed, so steady play doesn't touch the heap.
+class SnapshotPublisher
+{
+private:
+
+	enum
+	{
+		maxFreeSnapshots = 64
+	};
+
+	struct Retired
+	{
+		uint32 version;
+		BoardSnapshot *pSnapshot;
+		BoardTile *pTile;
+	};
+
+	BoardSnapshot *_pLatest;
+	uint32 _nextVersion;
+	std::vector<Retired> _retired;
+	std::vector<BoardSnapshot*> _freeSnapshots;
+	std::vector<BoardTile*> _freeTiles;
+
+	// written by the reader, read by the publisher
+	volatile uint32 _readerVersion;
+
+	BoardSnapshot *beginVersion(const SakuraBoard &board);
+	void endVersion(BoardSnapshot *pNext);
+	BoardTile *copyTile(BoardSnapshot *pNext, int tileIndex);
+	BoardTile *allocateTile();
+	void retire(BoardSnapshot *pSnapshot, BoardTile *pTile);
+	void reclaim();
+
+	SnapshotPublisher(const SnapshotPublisher &);
+	SnapshotPublisher &operator = (const SnapshotPublisher &);
+
+public:
+
+	SnapshotPublisher();
+	~SnapshotPublisher();
+
+	// Publisher side. Every tile that differs from the board is copied; a board of another size gets all new tiles.
+	const BoardSnapshot *publish(const SakuraBoard &board);
+
+	// Only the tiles of the given cells are compared and copied.
+	const BoardSnapshot *publish(const SakuraBoard &board, const std::vector<int> &cellIndices);
+
+	const BoardSnapshot *getLatest() const
+	{
+		return _pLatest;
+	}
+
+	// Reader side: the reader has switched to the given snapshot and won't look at any older one.
+	void setReaderVersion(uint32 version)
+	{
+		SAKURA_MEMORY_BARRIER();
+
+		_readerVersion = version;
+	}
+
+	size_t getMemoryUsage() const;
+};
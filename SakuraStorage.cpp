@@ -0,0 +1,383 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraStorage.h"
+
+#if JUCE_WIN32
+	// juce's T() macro clashes with the template parameters used inside the windows headers
+	#pragma push_macro("T")
+	#undef T
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#pragma pop_macro("T")
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+	_pData(0),
+	_size(0),
+#if JUCE_WIN32
+	_hFile(INVALID_HANDLE_VALUE),
+	_hMapping(0)
+#else
+	_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const File &file)
+{
+	close();
+
+#if JUCE_WIN32
+	_hFile = CreateFileW((const WCHAR*)(const tchar*)file.getFullPathName(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+	if(_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+
+	if(!GetFileSizeEx(_hFile, &size) || size.QuadPart <= 0)
+	{
+		close();
+		return false;
+	}
+
+	_hMapping = CreateFileMappingW(_hFile, 0, PAGE_READONLY, 0, 0, 0);
+
+	if(!_hMapping)
+	{
+		close();
+		return false;
+	}
+
+	_pData = (const uint8*)MapViewOfFile(_hMapping, FILE_MAP_READ, 0, 0, 0);
+	_size = size_t(size.QuadPart);
+#else
+	_fd = ::open(file.getFullPathName().toUTF8(), O_RDONLY);
+
+	if(_fd < 0)
+		return false;
+
+	struct stat info;
+
+	if(fstat(_fd, &info) != 0 || info.st_size <= 0)
+	{
+		close();
+		return false;
+	}
+
+	void *p = mmap(0, size_t(info.st_size), PROT_READ, MAP_PRIVATE, _fd, 0);
+
+	if(p == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	_pData = (const uint8*)p;
+	_size = size_t(info.st_size);
+#endif
+
+	if(!_pData)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#if JUCE_WIN32
+	if(_pData)
+		UnmapViewOfFile(_pData);
+
+	if(_hMapping)
+		CloseHandle(_hMapping);
+
+	if(_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(_hFile);
+
+	_hFile = INVALID_HANDLE_VALUE;
+	_hMapping = 0;
+#else
+	if(_pData)
+		munmap((void*)_pData, _size);
+
+	if(_fd >= 0)
+		::close(_fd);
+
+	_fd = -1;
+#endif
+
+	_pData = 0;
+	_size = 0;
+}
+
+bool BoardStorage::save(const File &file, const BoardState &state)
+{
+	if(state.width <= 0 || state.height <= 0 || int(state.cells.size()) != state.width * state.height)
+		return false;
+
+	file.getParentDirectory().createDirectory();
+
+	File tempFile(file.getSiblingFile(file.getFileName() + T(".tmp")));
+	tempFile.deleteFile();
+
+	bool written = false;
+
+	{
+		FileOutputStream out(tempFile, 256 * 1024);
+
+		if(!out.failedToOpen())
+		{
+			out.write("SKRS", 4);
+			out.writeShort(short(version));
+			out.writeShort(short(state.infiniteMode ? infiniteModeFlag : 0));
+			out.writeInt(state.width);
+			out.writeInt(state.height);
+			out.writeInt(state.rootX);
+			out.writeInt(state.rootY);
+			out.writeInt(int(state.seed));
+			out.writeInt(int(state.relax * 1000. + .5));
+
+			written = out.write(&state.cells[0], int(state.cells.size()));
+
+			out.flush();
+		}
+	}
+
+	// the stream is buffered, so a write that failed on the last flush only shows in the size;
+	// whatever went wrong, no half-written file is left behind
+	if(!written || tempFile.getSize() != int64(headerSize) + int64(state.cells.size()))
+	{
+		tempFile.deleteFile();
+		return false;
+	}
+
+	file.deleteFile();
+
+	if(!tempFile.moveFileTo(file))
+	{
+		tempFile.deleteFile();
+		return false;
+	}
+
+	return true;
+}
+
+bool BoardStorage::Reader::open(const File &file)
+{
+	pCells = 0;
+
+	if(!_file.open(file) || _file.getSize() < size_t(headerSize))
+		return false;
+
+	const char *pData = (const char*)_file.getData();
+
+	if(memcmp(pData, "SKRS", 4) != 0 || littleEndianShort(pData + 4) != version)
+		return false;
+
+	header.infiniteMode = (littleEndianShort(pData + 6) & infiniteModeFlag) != 0;
+	header.width = int(littleEndianInt(pData + 8));
+	header.height = int(littleEndianInt(pData + 12));
+	header.rootX = int(littleEndianInt(pData + 16));
+	header.rootY = int(littleEndianInt(pData + 20));
+	header.seed = littleEndianInt(pData + 24);
+	header.relax = littleEndianInt(pData + 28) / 1000.;
+
+	// bounded as the codec bounds a board, and summed in 64 bits so a forged size can't wrap on 32-bit builds
+	if(header.width < 3 || header.height < 3 || header.width > 0xffff || header.height > 0xffff ||
+		header.rootX < 0 || header.rootX >= header.width ||
+		header.rootY < 0 || header.rootY >= header.height ||
+		uint64(_file.getSize()) < uint64(headerSize) + uint64(header.width) * uint64(header.height))
+		return false;
+
+	pCells = _file.getData() + headerSize;
+
+	return true;
+}
+
+bool PuzzlePack::open(const File &file)
+{
+	close();
+
+	if(!_file.open(file) || _file.getSize() < size_t(headerSize))
+		return false;
+
+	const char *pData = (const char*)_file.getData();
+
+	if(memcmp(pData, "SKRP", 4) != 0 || littleEndianShort(pData + 4) != version)
+	{
+		close();
+		return false;
+	}
+
+	uint32 count = littleEndianInt(pData + 8);
+	uint64 indexOffset = uint64(littleEndianInt(pData + 16)) | (uint64(littleEndianInt(pData + 20)) << 32);
+
+	// checked so that a forged count or offset can't wrap around
+	if(indexOffset > uint64(_file.getSize()) || uint64(count) > (uint64(_file.getSize()) - indexOffset) / 8)
+	{
+		close();
+		return false;
+	}
+
+	_count = count;
+	_pIndex = _file.getData() + size_t(indexOffset);
+
+	return true;
+}
+
+bool PuzzlePack::getPuzzle(int index, PuzzleRecord &record) const
+{
+	if(!isOpen() || index < 0 || uint32(index) >= _count)
+		return false;
+
+	const char *pEntry = (const char*)_pIndex + (index * 8);
+	uint64 offset = uint64(littleEndianInt(pEntry)) | (uint64(littleEndianInt(pEntry + 4)) << 32);
+
+	if(offset > uint64(_file.getSize()) || uint64(_file.getSize()) - offset < uint64(recordHeaderSize))
+		return false;
+
+	const char *pRecord = (const char*)_file.getData() + size_t(offset);
+
+	record.width = littleEndianShort(pRecord);
+	record.height = littleEndianShort(pRecord + 2);
+	record.rootX = littleEndianShort(pRecord + 4);
+	record.rootY = littleEndianShort(pRecord + 6);
+	record.infiniteMode = (littleEndianShort(pRecord + 8) & infiniteModeFlag) != 0;
+	record.relax = littleEndianShort(pRecord + 10) / 1000.;
+	record.seed = littleEndianInt(pRecord + 12);
+	record.pMasks = (const uint8*)pRecord + recordHeaderSize;
+
+	return record.width >= 3 && record.height >= 3 &&
+		record.rootX < record.width && record.rootY < record.height &&
+		(uint64(record.width) * uint64(record.height) + 1) / 2 <= uint64(_file.getSize()) - offset - recordHeaderSize;
+}
+
+void PuzzlePackWriter::writeInt64(uint64 value)
+{
+	_pOut->writeInt(int(uint32(value)));
+	_pOut->writeInt(int(uint32(value >> 32)));
+}
+
+bool PuzzlePackWriter::open(const File &file)
+{
+	close();
+
+	file.deleteFile();
+
+	_pOut = new FileOutputStream(file, 256 * 1024);
+
+	if(_pOut->failedToOpen())
+	{
+		deleteAndZero(_pOut);
+		return false;
+	}
+
+	_file = file;
+	_failed = false;
+	_offsets.clear();
+
+	_pOut->write("SKRP", 4);
+	_pOut->writeShort(short(PuzzlePack::version));
+	_pOut->writeShort(0);
+	_pOut->writeInt(0);
+	_pOut->writeInt(0);
+	writeInt64(0);
+
+	return true;
+}
+
+bool PuzzlePackWriter::addPuzzle(const BoardState &state)
+{
+	if(!_pOut || state.width < 3 || state.height < 3 || state.width > 0xffff || state.height > 0xffff ||
+		int(state.cells.size()) != state.width * state.height)
+		return false;
+
+	_offsets.push_back(uint64(_pOut->getPosition()));
+
+	_pOut->writeShort(short(state.width));
+	_pOut->writeShort(short(state.height));
+	_pOut->writeShort(short(state.rootX));
+	_pOut->writeShort(short(state.rootY));
+	_pOut->writeShort(short(state.infiniteMode ? PuzzlePack::infiniteModeFlag : 0));
+	_pOut->writeShort(short(state.relax * 1000. + .5));
+	_pOut->writeInt(int(state.seed));
+
+	_masks.assign((state.cells.size() + 1) / 2, 0);
+
+	for(size_t idx = 0, size = state.cells.size(); idx < size; idx++)
+		_masks[idx >> 1] |= uint8((state.cells[idx] & 0x0f) << ((idx & 1) << 2));
+
+	if(!_pOut->write(&_masks[0], int(_masks.size())))
+		_failed = true;
+
+	return !_failed;
+}
+
+bool PuzzlePackWriter::close()
+{
+	if(!_pOut)
+		return false;
+
+	uint64 indexOffset = uint64(_pOut->getPosition());
+
+	for(std::vector<uint64>::iterator it = _offsets.begin(), end = _offsets.end(); it != end; ++it)
+		writeInt64(*it);
+
+	_pOut->flush();
+
+	if(!_pOut->setPosition(8))
+		_failed = true;
+
+	_pOut->writeInt(int(_offsets.size()));
+	_pOut->writeInt(0);
+	writeInt64(indexOffset);
+	_pOut->flush();
+
+	deleteAndZero(_pOut);
+
+	// the stream is buffered, so a write that failed on the way only shows in the size,
+	// or in the header the pack is read back with
+	PuzzlePack pack;
+
+	if(_failed || uint64(_file.getSize()) != indexOffset + (uint64(_offsets.size()) * 8) ||
+		!pack.open(_file) || pack.getNumPuzzles() != int(_offsets.size()))
+	{
+		pack.close();
+		_file.deleteFile();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+
+#include <vector>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+private:
+
+	const uint8 *_pData;
+	size_t _size;
+
+#if JUCE_WIN32
+	void *_hFile;
+	void *_hMapping;
+#else
+	int _fd;
+#endif
+
+	MappedFile(const MappedFile &);
+	MappedFile &operator = (const MappedFile &);
+
+public:
+
+	MappedFile();
+	~MappedFile();
+
+	bool open(const File &file);
+	void close();
+
+	bool isOpen() const
+	{
+		return _pData != 0;
+	}
+
+	const uint8 *getData() const
+	{
+		return _pData;
+	}
+
+	size_t getSize() const
+	{
+		return _size;
+	}
+};
+
+// Everything needed to bring a board back exactly as it was left.
+// Each cell takes one byte: the original directions in the low nibble, the current ones in the high nibble.
+struct BoardState
+{
+	int width;
+	int height;
+	int rootX;
+	int rootY;
+	bool infiniteMode;
+	double relax;
+	uint32 seed;
+
+	std::vector<uint8> cells;
+
+	BoardState() :
+		width(0),
+		height(0),
+		rootX(0),
+		rootY(0),
+		infiniteMode(false),
+		relax(.0),
+		seed(0)
+	{
+	}
+};
+
+// Save file layout (all values little-endian):
+//
+//   0  'SKRS'
+//   4  uint16 version
+//   6  uint16 flags (bit 0: infinite mode)
+//   8  int32  width
+//  12  int32  height
+//  16  int32  root x
+//  20  int32  root y
+//  24  uint32 seed
+//  28  uint32 relax value in thousandths
+//  32  width * height cell bytes, row by row
+class BoardStorage
+{
+public:
+
+	enum
+	{
+		headerSize = 32,
+		version = 1,
+		infiniteModeFlag = 1
+	};
+
+	static bool save(const File &file, const BoardState &state);
+
+	// Maps the file and checks its header; on success pCells points straight into the mapping.
+	class Reader
+	{
+	private:
+
+		MappedFile _file;
+
+	public:
+
+		BoardState header;
+		const uint8 *pCells;
+
+		Reader() : pCells(0)
+		{
+		}
+
+		bool open(const File &file);
+	};
+};
+
+// One puzzle of a pack, read in place from the mapped file.
+// The masks hold the solved directions of every cell, two cells per byte, the lower nibble first.
+struct PuzzleRecord
+{
+	int width;
+	int height;
+	int rootX;
+	int rootY;
+	bool infiniteMode;
+	double relax;
+	uint32 seed;
+	const uint8 *pMasks;
+
+	PuzzleRecord() :
+		width(0),
+		height(0),
+		rootX(0),
+		rootY(0),
+		infiniteMode(false),
+		relax(.0),
+		seed(0),
+		pMasks(0)
+	{
+	}
+
+	int getMask(int cellIndex) const
+	{
+		return (pMasks[cellIndex >> 1] >> ((cellIndex & 1) << 2)) & 0x0f;
+	}
+};
+
+// Pack file layout (all values little-endian):
+//
+//   0  'SKRP'
+//   4  uint16 version
+//   6  uint16 reserved
+//   8  uint32 number of puzzles
+//  12  uint32 reserved
+//  16  uint64 offset of the index
+//
+// The index is an array of uint64 record offsets, one per puzzle. Every record is:
+//
+//   0  uint16 width
+//   2  uint16 height
+//   4  uint16 root x
+//   6  uint16 root y
+//   8  uint16 flags (bit 0: infinite mode)
+//  10  uint16 relax value in thousandths
+//  12  uint32 seed
+//  16  (width * height + 1) / 2 bytes of masks
+class PuzzlePack
+{
+private:
+
+	MappedFile _file;
+	uint32 _count;
+	const uint8 *_pIndex;
+
+public:
+
+	enum
+	{
+		headerSize = 24,
+		recordHeaderSize = 16,
+		version = 1,
+		infiniteModeFlag = 1
+	};
+
+	PuzzlePack() :
+		_count(0),
+		_pIndex(0)
+	{
+	}
+
+	bool open(const File &file);
+
+	void close()
+	{
+		_file.close();
+		_count = 0;
+		_pIndex = 0;
+	}
+
+	bool isOpen() const
+	{
+		return _pIndex != 0;
+	}
+
+	int getNumPuzzles() const
+	{
+		return int(_count);
+	}
+
+	bool getPuzzle(int index, PuzzleRecord &record) const;
+};
+
+// Streams puzzles into a pack; the index is appended when the writer is closed.
+class PuzzlePackWriter
+{
+private:
+
+	File _file;
+	FileOutputStream *_pOut;
+	std::vector<uint64> _offsets;
+	std::vector<uint8> _masks;
+	bool _failed;
+
+	void writeInt64(uint64 value);
+
+public:
+
+	PuzzlePackWriter() :
+		_pOut(0),
+		_failed(false)
+	{
+	}
+
+	~PuzzlePackWriter()
+	{
+		close();
+	}
+
+	bool open(const File &file);
+	bool addPuzzle(const BoardState &state);
+
+	// Returns false, deleting the pack, if anything written to it since open() didn't make it to the file.
+	bool close();
+};
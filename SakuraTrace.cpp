@@ -0,0 +1,121 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "SakuraTrace.h"
+
+TraceLog::ThreadBuffer * volatile TraceLog::__buffers[TraceLog::maxThreads] = { 0 };
+int TraceLog::__numBuffers = 0;
+bool TraceLog::__enabled = false;
+int64 TraceLog::__origin = 0;
+File TraceLog::__file;
+
+void TraceLog::enable(const File &file)
+{
+	__file = file;
+	__origin = Time::getHighResolutionTicks();
+	__enabled = true;
+}
+
+// A thread claims a slot with its first event; the slot is published only once the buffer is set up,
+// so the other threads scanning the table never see a half-built one.
+TraceLog::ThreadBuffer *TraceLog::getThreadBuffer()
+{
+	int threadId = Thread::getCurrentThreadId();
+	int numBuffers = jmin(int(__numBuffers), int(maxThreads));
+
+	for(int idx = 0; idx < numBuffers; idx++)
+	{
+		ThreadBuffer *pBuffer = __buffers[idx];
+
+		if(pBuffer && pBuffer->threadId == threadId)
+			return pBuffer;
+	}
+
+	int slot = atomicIncrementAndReturn(__numBuffers) - 1;
+
+	if(slot >= maxThreads)
+		return 0;
+
+	ThreadBuffer *pBuffer = new ThreadBuffer();
+	pBuffer->threadId = threadId;
+	pBuffer->head = 0;
+
+	__buffers[slot] = pBuffer;
+
+	return pBuffer;
+}
+
+bool TraceLog::flush()
+{
+	if(!__enabled)
+		return false;
+
+	__enabled = false;
+
+	__file.getParentDirectory().createDirectory();
+	__file.deleteFile();
+
+	FileOutputStream out(__file, 256 * 1024);
+
+	if(out.failedToOpen())
+		return false;
+
+	out.writeText(T("{\"traceEvents\":[\n"), false, false);
+
+	bool first = true;
+
+	for(int slot = 0; slot < maxThreads; slot++)
+	{
+		ThreadBuffer *pBuffer = __buffers[slot];
+
+		if(!pBuffer)
+			continue;
+
+		uint32 count = (pBuffer->head < uint32(eventsPerThread)) ? pBuffer->head : uint32(eventsPerThread);
+
+		for(uint32 idx = pBuffer->head - count; idx != pBuffer->head; idx++)
+		{
+			const Event &event = pBuffer->events[idx & (eventsPerThread - 1)];
+
+			String line(first ? T("") : T(",\n"));
+			line << T("{\"name\":\"") << event.pName << T("\",\"ph\":\"X\",\"pid\":1,\"tid\":") << pBuffer->threadId
+				<< T(",\"ts\":") << String(Time::highResolutionTicksToSeconds(event.start - __origin) * 1000000., 1)
+				<< T(",\"dur\":") << String(Time::highResolutionTicksToSeconds(event.duration) * 1000000., 1);
+
+			if(event.argument != noArgument)
+				line << T(",\"args\":{\"id\":") << event.argument << T("}");
+
+			line << T("}");
+
+			out.writeText(line, false, false);
+			first = false;
+		}
+
+		delete pBuffer;
+		__buffers[slot] = 0;
+	}
+
+	out.writeText(T("\n]}\n"), false, false);
+	out.flush();
+
+	__numBuffers = 0;
+
+	return true;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+/***************************************************************************
+ *   Copyright (C) 2008 by Arlen Albert Keshabyan                          *
+ *   <arlen.albert@gmail.com>                                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "juce/juce_amalgamated.h"
+
+// Interaction trace in the Chrome trace event format (chrome://tracing, Perfetto).
+// Every traced scope becomes one complete event, written into a ring buffer owned by the calling thread,
+// so recording takes no lock; when a buffer wraps around, the oldest events are dropped.
+// The buffers are written out by flush(), once the other threads are done.
+// The scopes are compiled in only with SAKURA_TRACING, and record nothing until the trace is enabled.
+class TraceLog
+{
+public:
+
+	enum
+	{
+		eventsPerThread = 1 << 16,
+		maxThreads = 16,
+		noArgument = -1
+	};
+
+private:
+
+	struct Event
+	{
+		const char *pName;
+		int64 start;
+		int64 duration;
+		int argument;
+	};
+
+	struct ThreadBuffer
+	{
+		int threadId;
+		uint32 head;
+		Event events[eventsPerThread];
+	};
+
+	static ThreadBuffer * volatile __buffers[maxThreads];
+	static int __numBuffers;
+	static bool __enabled;
+	static int64 __origin;
+	static File __file;
+
+	static ThreadBuffer *getThreadBuffer();
+
+public:
+
+	// Starts recording; the trace goes to the given file on flush().
+	static void enable(const File &file);
+
+	static bool isEnabled()
+	{
+		return __enabled;
+	}
+
+	// The name has to be a literal, only the pointer is kept.
+	static void record(const char *pName, int64 start, int64 end, int argument)
+	{
+		ThreadBuffer *pBuffer = getThreadBuffer();
+
+		if(!pBuffer)
+			return;
+
+		Event &event = pBuffer->events[pBuffer->head & (eventsPerThread - 1)];
+
+		event.pName = pName;
+		event.start = start;
+		event.duration = end - start;
+		event.argument = argument;
+
+		pBuffer->head++;
+	}
+
+	// Writes the recorded events and stops recording.
+	static bool flush();
+};
+
+class ScopedTrace
+{
+private:
+
+	const char *_pName;
+	int _argument;
+	int64 _start;
+
+public:
+
+	ScopedTrace(const char *pName, int argument = TraceLog::noArgument) :
+		_pName(pName),
+		_argument(argument),
+		_start(TraceLog::isEnabled() ? Time::getHighResolutionTicks() : 0)
+	{
+	}
+
+	~ScopedTrace()
+	{
+		if(_start && TraceLog::isEnabled())
+			TraceLog::record(_pName, _start, Time::getHighResolutionTicks(), _argument);
+	}
+};
+
+#ifdef SAKURA_TRACING
+#define SAKURA_TRACE_SCOPE(name) ScopedTrace __traceScope(name)
+#define SAKURA_TRACE_SCOPE_ARG(name, argument) ScopedTrace __traceScope(name, argument)
+#else
+#define SAKURA_TRACE_SCOPE(name)
+#define SAKURA_TRACE_SCOPE_ARG(name, argument)
+#endif